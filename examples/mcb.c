@@ -28,7 +28,7 @@ int main(int argc, char **argv)
   data->n_sim = 10;
 
   /* options */
-  while ((c = getopt(argc, argv, "i:b:s:mLI:")) != -1) {
+  while ((c = getopt(argc, argv, "i:b:s:mLI:Et:")) != -1) {
     switch (c) {
     case 'b':
       d = atof(optarg);
@@ -57,6 +57,17 @@ int main(int argc, char **argv)
     case 'L':
       do_log = FALSE;
       break;
+    case 'E':
+      data->exact_expectation = TRUE;
+      break;
+    case 't':
+      i = atoi(optarg);
+      if (i > 0) {
+	data->max_thread = i;
+      } else {
+	fprintf(stderr, "-t ignored: number of threads should be a positive integer\n");
+      }
+      break;
     case 'I':
       i = atoi(optarg);
       if (i >= 0) {
@@ -70,7 +81,7 @@ int main(int argc, char **argv)
     }
   }
 
-  srand(seed);
+  data->seed = seed;
 
   if (optind < argc) {
     f = fopen(argv[optind], "r");
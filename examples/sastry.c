@@ -68,7 +68,7 @@ int main(int argc, char **argv)
     }
   }
 
-  srand(seed);
+  data->seed = seed;
 
   if (optind < argc) {
     f = fopen(argv[optind], "r");
@@ -29,7 +29,7 @@ int main(int argc, char **argv)
   data->sampling_size = 10;
 
   /* options */
-  while ((c = getopt(argc, argv, "i:s:mLI:")) != -1) {
+  while ((c = getopt(argc, argv, "i:s:mLI:Et:")) != -1) {
     switch (c) {
     case 's':
       i = atoi(optarg);
@@ -50,6 +50,17 @@ int main(int argc, char **argv)
     case 'L':
       do_log = FALSE;
       break;
+    case 'E':
+      data->exact_expectation = TRUE;
+      break;
+    case 't':
+      i = atoi(optarg);
+      if (i > 0) {
+	data->max_thread = i;
+      } else {
+	fprintf(stderr, "-t ignored: number of threads should be a positive integer\n");
+      }
+      break;
     case 'I':
       i = atoi(optarg);
       if (i >= 0) {
@@ -63,7 +74,7 @@ int main(int argc, char **argv)
     }
   }
 
-  srand(seed);
+  data->seed = seed;
 
   if (optind < argc) {
     f = fopen(argv[optind], "r");
@@ -65,6 +65,7 @@ int main(int argc, char **argv)
   tmp.n_players = 2;
   tmp.n_strategies = 3;
   data = gatha_sastry_data_new(&tmp);
+  data->seed = time(NULL);
   data->b = 0.000001;
 
   f = fopen(argv[1], "r");
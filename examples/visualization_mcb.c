@@ -64,6 +64,7 @@ int main(int argc, char **argv)
   tmp.n_players = 2;
   tmp.n_strategies = 4;
   data = gatha_mcb_data_new(&tmp);
+  data->seed = time(NULL);
   data->b = 0.001;
 
   f = fopen(argv[1], "r");
@@ -69,6 +69,7 @@ int main(int argc, char **argv)
   tmp.n_players = 2;
   tmp.n_strategies = 3;
   data = gatha_sfp_data_new(&tmp);
+  data->seed = time(NULL);
 
   f = fopen(argv[1], "r");
   mat = gatha_payoff_matrix_2p_from_file(f);
@@ -0,0 +1,238 @@
+#include "anonymous_game.h"
+#include "game.h"
+
+#include <string.h>
+
+GathaAnonymousGame* gatha_anonymous_game_new(int p, int s)
+{
+  GathaAnonymousGame *ag;
+
+  assert(p > 1 && s > 0);
+
+  ag = (GathaAnonymousGame *) malloc(sizeof(GathaAnonymousGame));
+  if (ag == NULL) return NULL;
+
+  ag->n_players = p;
+  ag->n_strategies = s;
+  ag->payoffs = (payoff_t*) calloc((long) s * p, sizeof(payoff_t));
+  assert(ag->payoffs != NULL);
+  ag->cached_proba = NULL;
+  ag->distributions = NULL;
+  ag->prepared_proba = NULL;
+
+  return ag;
+}
+
+void gatha_anonymous_game_free(GathaAnonymousGame *ag)
+{
+  assert(ag != NULL);
+  free(ag->payoffs);
+  free(ag->cached_proba);
+  free(ag->distributions);
+  free(ag);
+}
+
+static void anonymous_game_expected_payoffs(GathaGame *g, int player,
+					    proba_t **proba, payoff_t *payoffs,
+					    int thread_id)
+{
+  gatha_anonymous_game_expected_payoffs((GathaAnonymousGame*) g->data,
+					player, proba, payoffs);
+}
+
+static void anonymous_game_prepare(GathaGame *g, proba_t **proba)
+{
+  gatha_anonymous_game_prepare((GathaAnonymousGame*) g->data, proba);
+}
+
+GathaGame* gatha_game_from_anonymous(GathaAnonymousGame *ag)
+{
+  GathaGame *g;
+  assert(ag != NULL);
+  g = gatha_game_new(ag->n_players, ag->n_strategies);
+  g->payoff_func = gatha_anonymous_game_payoffs;
+  g->expected_payoffs_func = anonymous_game_expected_payoffs;
+  g->expected_payoffs_prepare_func = anonymous_game_prepare;
+  g->data = ag;
+  return g;
+}
+
+void gatha_anonymous_game_set(GathaAnonymousGame *ag, int a, int k,
+			      payoff_t value)
+{
+  assert(a >= 0 && a < ag->n_strategies);
+  assert(k >= 1 && k <= ag->n_players);
+  ag->payoffs[(long) a * ag->n_players + k - 1] = value;
+}
+
+payoff_t gatha_anonymous_game_get(GathaAnonymousGame *ag, int a, int k)
+{
+  assert(a >= 0 && a < ag->n_strategies);
+  assert(k >= 1 && k <= ag->n_players);
+  return ag->payoffs[(long) a * ag->n_players + k - 1];
+}
+
+/* number of strategies whose counts fit on the stack of the payoff callback */
+#define ANONYMOUS_GAME_STACK_STRATEGIES 256
+
+void gatha_anonymous_game_payoffs(GathaGame *g, int *actions,
+				  payoff_t *payoffs, int thread_id)
+{
+  GathaAnonymousGame *ag;
+  int i, n;
+  int stack_counts[ANONYMOUS_GAME_STACK_STRATEGIES];
+  int *counts;
+
+  ag = (GathaAnonymousGame*) g->data;
+  n = ag->n_players;
+
+  // number of players choosing each strategy; the callback is called for
+  // every simulation, so it only allocates for very large games
+  if (ag->n_strategies <= ANONYMOUS_GAME_STACK_STRATEGIES) {
+    counts = stack_counts;
+    memset(counts, 0, ag->n_strategies * sizeof(int));
+  } else {
+    counts = (int*) calloc(ag->n_strategies, sizeof(int));
+    assert(counts != NULL);
+  }
+  for(i=0 ; i<n ; i++) {
+    counts[actions[i]]++;
+  }
+  for(i=0 ; i<n ; i++) {
+    payoffs[i] = ag->payoffs[(long) actions[i] * n + counts[actions[i]] - 1];
+  }
+  if (counts != stack_counts) free(counts);
+}
+
+/* computes the distribution of the number of players choosing each strategy */
+static void anonymous_game_distributions(GathaAnonymousGame *ag, proba_t **proba)
+{
+  int a, i, k, n, width;
+  double q;
+  double *dist;
+
+  n = ag->n_players;
+  for(a=0 ; a<ag->n_strategies ; a++) {
+    dist = ag->distributions + (long) a * (n + 1);
+    dist[0] = 1.0;
+    width = 1;
+    for(i=0 ; i<n ; i++) {
+      q = proba[i][a];
+      if (q <= 0.0) continue;
+      // add a player choosing a with probability q
+      dist[width] = dist[width-1] * q;
+      for(k=width-1 ; k>0 ; k--) {
+	dist[k] = dist[k] * (1.0 - q) + dist[k-1] * q;
+      }
+      dist[0] *= 1.0 - q;
+      width++;
+    }
+    for(k=width ; k<=n ; k++) {
+      dist[k] = 0.0;
+    }
+  }
+}
+
+/* updates the cached distributions if the probability vectors changed; the
+   caller holds the lock */
+static void anonymous_game_update_cache(GathaAnonymousGame *ag,
+					proba_t **proba)
+{
+  int i, n, s;
+  boolean changed;
+
+  n = ag->n_players;
+  s = ag->n_strategies;
+  if (ag->cached_proba == NULL) {
+    ag->cached_proba = (proba_t*) malloc((long) n * s * sizeof(proba_t));
+    ag->distributions = (double*) malloc((long) s * (n + 1) * sizeof(double));
+    assert(ag->cached_proba != NULL && ag->distributions != NULL);
+    changed = TRUE;
+  } else {
+    changed = FALSE;
+    for(i=0 ; i<n && !changed ; i++) {
+      changed = memcmp(ag->cached_proba + (long) i * s, proba[i],
+		       s * sizeof(proba_t)) != 0;
+    }
+  }
+  if (changed) {
+    for(i=0 ; i<n ; i++) {
+      memcpy(ag->cached_proba + (long) i * s, proba[i], s * sizeof(proba_t));
+    }
+    anonymous_game_distributions(ag, proba);
+  }
+}
+
+void gatha_anonymous_game_prepare(GathaAnonymousGame *ag, proba_t **proba)
+{
+  assert(ag != NULL);
+  #pragma omp critical (gatha_anonymous_game_cache)
+  {
+    if (proba != NULL) anonymous_game_update_cache(ag, proba);
+    // published after the distributions, for the threads that skip the lock
+    #pragma omp atomic write seq_cst
+    ag->prepared_proba = proba;
+  }
+}
+
+void gatha_anonymous_game_expected_payoffs(GathaAnonymousGame *ag,
+					   int player, proba_t **proba,
+					   payoff_t *payoffs)
+{
+  int a, k, n, s;
+  double q, sum;
+  // the distribution of all the players, and the one of the opponents
+  const double *all;
+  double *others;
+  const payoff_t *row;
+  proba_t **prepared;
+
+  n = ag->n_players;
+  s = ag->n_strategies;
+  assert(player >= 0 && player < n);
+
+  // the game may be shared by several threads; once prepared, the cache is
+  // trusted until the next preparation
+  #pragma omp atomic read seq_cst
+  prepared = ag->prepared_proba;
+  if (proba != prepared) {
+    #pragma omp critical (gatha_anonymous_game_cache)
+    {
+      anonymous_game_update_cache(ag, proba);
+      #pragma omp atomic write seq_cst
+      ag->prepared_proba = NULL;
+    }
+  }
+
+  others = (double*) malloc(n * sizeof(double));
+  assert(others != NULL);
+
+  // the distributions do not change while the threads read them
+  for(a=0 ; a<s ; a++) {
+    all = ag->distributions + (long) a * (n + 1);
+    q = proba[player][a];
+    // remove the player, dividing by (1-q + q x); the recurrence is run
+    // in the direction where errors are not amplified
+    if (q <= 0.5) {
+      others[0] = all[0] / (1.0 - q);
+      for(k=1 ; k<n ; k++) {
+	others[k] = (all[k] - q * others[k-1]) / (1.0 - q);
+      }
+    } else {
+      others[n-1] = all[n] / q;
+      for(k=n-1 ; k>0 ; k--) {
+	others[k-1] = (all[k] - (1.0 - q) * others[k]) / q;
+      }
+    }
+
+    // the player itself is one of the players choosing a
+    row = ag->payoffs + (long) a * n;
+    sum = 0.0;
+    for(k=0 ; k<n ; k++) {
+      sum += others[k] * row[k];
+    }
+    payoffs[a] = sum;
+  }
+
+  free(others);
+}
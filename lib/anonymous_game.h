@@ -0,0 +1,98 @@
+#ifndef _GATHA_ANONYMOUS_GAME_H_
+#define _GATHA_ANONYMOUS_GAME_H_
+
+#include "types.h"
+
+/** Anonymous game, in its congestion form: the payoff of a player only
+ *  depends on its own strategy and on the number of players choosing the
+ *  same strategy, itself included. Each strategy can be seen as a resource
+ *  with a payoff (or a negated cost) function of its load. Only
+ *  n_strategies * n_players payoffs are stored. */
+struct _gatha_anonymous_game {
+
+  /** Number of players in the game. */
+  int n_players;
+
+  /** Number of strategies for each player. */
+  int n_strategies;
+
+  /** Payoffs: payoffs[a*n_players + k-1] is the payoff of a player choosing
+   * strategy a when k players, itself included, choose it. */
+  payoff_t *payoffs;
+
+  /** Copy of the probability vectors `distributions' was computed for, or
+   * NULL. */
+  proba_t *cached_proba;
+
+  /** distributions[a*(n_players+1) + k] is the probability that k players
+   * choose strategy a, for the probability vectors in `cached_proba'. The
+   * distribution of the opponents of a player is derived from it in linear
+   * time, so it is only computed once for all the players.
+   * \see gatha_anonymous_game_expected_payoffs */
+  double *distributions;
+
+  /** Probability vectors given to the last gatha_anonymous_game_prepare,
+   * whose `distributions' are used without checking them, or NULL. */
+  proba_t **prepared_proba;
+} ;
+
+/** Creates a GathaAnonymousGame, with all payoffs set to 0.
+ * @param np Number of players.
+ * @param ns Number of strategies for each player.
+ */
+extern GathaAnonymousGame* gatha_anonymous_game_new(int np, int ns);
+
+/** Frees a GathaAnonymousGame. */
+extern void gatha_anonymous_game_free(GathaAnonymousGame *ag);
+
+/** Creates a game using an anonymous game for computing the payoffs. */
+extern GathaGame* gatha_game_from_anonymous(GathaAnonymousGame *ag);
+
+/** Sets the payoff of choosing strategy a when k players choose it.
+ * @param ag The game
+ * @param a The strategy
+ * @param k The number of players choosing it, between 1 and n_players
+ * @param value The new payoff value
+ */
+extern void gatha_anonymous_game_set(GathaAnonymousGame *ag, int a, int k,
+				     payoff_t value);
+
+/** Retrieves the payoff of choosing strategy a when k players choose it. */
+extern payoff_t gatha_anonymous_game_get(GathaAnonymousGame *ag, int a, int k);
+
+/** Retrieves the players' payoffs for a choice of strategies. This is the
+ * payoff callback used by gatha_game_from_anonymous.
+ * \see gatha_payoff_matrix_payoffs
+ */
+extern void gatha_anonymous_game_payoffs(GathaGame *g, int *actions,
+					 payoff_t *payoffs, int thread_id);
+
+/** Computes the exact expected payoff of each strategy of a player, when the
+ * other players choose their strategies according to their probability vectors.
+ * For each strategy, the distribution of the number of players choosing it
+ * (a Poisson binomial distribution) is computed by dynamic programming, one
+ * player at a time, in O(n_strategies * n_players^2). It is cached until the
+ * probability vectors change, and the player is then removed from it in
+ * O(n_strategies * n_players): the expected payoffs of all the players cost
+ * about as much as the ones of a single player. Threads calling it at the
+ * same time must give the same probability vectors: only the check of the
+ * cache is done under a lock.
+ * \see gatha_payoff_matrix_expected_payoffs
+ */
+extern void gatha_anonymous_game_expected_payoffs(GathaAnonymousGame *ag,
+						  int player, proba_t **proba,
+						  payoff_t *payoffs);
+
+/** Computes the distributions of the number of players choosing each
+ * strategy, unless they are cached. Until the next call, the expected
+ * payoffs for the same probability vectors use them without comparing the
+ * vectors with the cached copy, and without a lock: the vectors must not
+ * change in the meantime. With NULL vectors, the next expected payoffs
+ * check the cache again. This is the `expected_payoffs_prepare_func' of
+ * gatha_game_from_anonymous, called by MCB and SFP once per iteration, and
+ * with NULL at the end of a run.
+ */
+extern void gatha_anonymous_game_prepare(GathaAnonymousGame *ag,
+					 proba_t **proba);
+
+#endif /* _GATHA_ANONYMOUS_GAME_H_ */
@@ -1,6 +1,8 @@
 #include "game.h"
 #include "payoff_matrix.h"
 
+#include <string.h>
+
 GathaGame* gatha_game_new(int np, int ns)
 {
   GathaGame *g;
@@ -11,6 +13,9 @@ GathaGame* gatha_game_new(int np, int ns)
   g->n_players = np;
   g->n_strategies = ns;
   g->payoff_func = NULL;
+  g->payoff_batch_func = gatha_game_payoffs_batch_adapter;
+  g->expected_payoffs_func = NULL;
+  g->expected_payoffs_prepare_func = NULL;
   g->data = NULL;
   return g;
 }
@@ -20,41 +25,115 @@ void gatha_game_free(GathaGame *g)
   free(g);
 }
 
+void gatha_game_payoffs_batch_adapter(GathaGame *g, const int *profiles,
+				      int count, payoff_t *payoffs,
+				      int thread_id)
+{
+  int i, n;
+
+  n = g->n_players;
+  for(i=0 ; i<count ; i++) {
+    g->payoff_func(g, (int*) profiles + i * n, payoffs + i * n, thread_id);
+  }
+}
+
+void gatha_game_payoffs_batch(GathaGame *g, const int *profiles, int count,
+			      payoff_t *payoffs, int thread_id)
+{
+  if (g->payoff_batch_func != NULL) {
+    g->payoff_batch_func(g, profiles, count, payoffs, thread_id);
+  } else {
+    gatha_game_payoffs_batch_adapter(g, profiles, count, payoffs, thread_id);
+  }
+}
+
+static void game_matrix_expected_payoffs(GathaGame *g, int player,
+					 proba_t **proba, payoff_t *payoffs,
+					 int thread_id)
+{
+  gatha_payoff_matrix_expected_payoffs((GathaPayoffMatrix*) g->data, player,
+				       proba, payoffs);
+}
+
+/* builds the per-player copy of the payoffs before the threads need it */
+static void game_matrix_expected_payoffs_prepare(GathaGame *g, proba_t **proba)
+{
+  GathaPayoffMatrix *m;
+
+  m = (GathaPayoffMatrix*) g->data;
+  if (m->player_payoffs == NULL) gatha_payoff_matrix_build_player_payoffs(m);
+}
+
 GathaGame* gatha_game_from_matrix(GathaPayoffMatrix *m)
 {
   GathaGame *g;
   assert(m != NULL);
   g = gatha_game_new(m->n_players, m->n_strategies);
   g->payoff_func = gatha_payoff_matrix_payoffs;
+  g->expected_payoffs_func = game_matrix_expected_payoffs;
+  g->expected_payoffs_prepare_func = game_matrix_expected_payoffs_prepare;
   g->data = m;
   return g;
 }
 
+/* size of the row pointers at the start of a pvect block */
+static inline size_t game_pvect_header_size(int n)
+{
+  return (n * sizeof(proba_t*) + GATHA_PVECT_ALIGN - 1)
+    & ~((size_t) GATHA_PVECT_ALIGN - 1);
+}
+
+int gatha_game_pvect_stride(GathaGame *g)
+{
+  int k;
+
+  k = GATHA_PVECT_ALIGN / sizeof(proba_t);
+  return (g->n_strategies + k - 1) / k * k;
+}
+
+void* gatha_aligned_malloc(size_t size)
+{
+  void *p;
+
+  size = (size + GATHA_PVECT_ALIGN - 1) & ~((size_t) GATHA_PVECT_ALIGN - 1);
+  if (posix_memalign(&p, GATHA_PVECT_ALIGN, size) != 0) return NULL;
+  return p;
+}
+
 proba_t** gatha_game_pvect_new(GathaGame *g)
 {
-  int n, m, i;
+  int n, i, stride;
+  size_t header, size;
   proba_t **proba;
+  proba_t *block;
+  void *p;
 
   n = g->n_players;
-  m = g->n_strategies;
+  stride = gatha_game_pvect_stride(g);
+  header = game_pvect_header_size(n);
+  size = header + (size_t) n * stride * sizeof(proba_t);
 
-  proba = (proba_t**) malloc(n * sizeof(proba_t*));
+  // a single block: the row pointers, then the rows, whose padding stays 0
+  p = gatha_aligned_malloc(size);
+  if (p == NULL) return NULL;
+  memset(p, 0, size);
+
+  proba = (proba_t**) p;
+  block = (proba_t*) ((char*) p + header);
   for(i=0 ; i<n ; i++) {
-    proba[i] = (proba_t*)malloc(m*sizeof(proba_t));
+    proba[i] = block + (size_t) i * stride;
   }
 
   return proba;
 }
 
-void gatha_game_pvect_free(GathaGame *g, proba_t **proba)
+proba_t* gatha_game_pvect_block(GathaGame *g, proba_t **proba)
 {
-  int n, i;
-
-  n = g->n_players;
+  return (proba_t*) ((char*) proba + game_pvect_header_size(g->n_players));
+}
 
-  for(i=0 ; i<n ; i++) {
-    free(proba[i]);
-  }
+void gatha_game_pvect_free(GathaGame *g, proba_t **proba)
+{
   free(proba);
 }
 
@@ -72,37 +151,74 @@ void gatha_game_pvect_fprintf(GathaGame *g, proba_t **proba, FILE *f)
   fprintf(f, "\n");
 }
 
+/* divides a row by its sum */
+static inline void game_pvect_normalize_row(proba_t *p, int m)
+{
+  int i;
+  proba_t sum;
+
+  sum = 0;
+  for(i=0;i<m;i++) {
+    sum += p[i];
+  }
+  for(i=0;i<m;i++) {
+    p[i] /= sum;
+  }
+}
+
 void gatha_game_pvect_normalize(GathaGame *g, proba_t **proba)
 {
-  int i, n, m;
-  proba_t sum=0;
+  int n, m, stride;
   proba_t *p;
-  int player;
 
   n = g->n_players;
   m = g->n_strategies;
+  stride = gatha_game_pvect_stride(g);
+  p = gatha_game_pvect_block(g, proba);
 
-  for(player=0 ; player<n ; player++) {
-    p = proba[player];
-    sum=0;
-
-    for(i=0;i<m;i++) {
-      sum += p[i];
-    }
-    for(i=0;i<m;i++) {
-      p[i] /= sum;
-    }
+  for( ; n>0 ; n--, p+=stride) {
+    game_pvect_normalize_row(p, m);
   }
 }
 
+void gatha_game_pvect_normalize_player(GathaGame *g, proba_t **proba,
+				       int player)
+{
+  game_pvect_normalize_row(proba[player], g->n_strategies);
+}
+
 void gatha_game_pvect_uniformize(GathaGame *g, proba_t **proba)
 {
-  int i, j, n, m;
+  int i, n, m, stride;
+  proba_t *p;
+
   n = g->n_players;
   m = g->n_strategies;
-  for(i=0;i<n;i++) {
-    for(j=0;j<m;j++) {
-      proba[i][j] = 1.0/m;
+  stride = gatha_game_pvect_stride(g);
+  p = gatha_game_pvect_block(g, proba);
+
+  for( ; n>0 ; n--, p+=stride) {
+    for(i=0;i<m;i++) {
+      p[i] = 1.0/m;
     }
   }
 }
+
+boolean gatha_game_has_expected_payoffs(GathaGame *g)
+{
+  return g->expected_payoffs_func != NULL;
+}
+
+boolean gatha_game_expected_payoffs(GathaGame *g, int player, proba_t **proba,
+				    payoff_t *payoffs, int thread_id)
+{
+  if (g->expected_payoffs_func == NULL) return FALSE;
+  g->expected_payoffs_func(g, player, proba, payoffs, thread_id);
+  return TRUE;
+}
+
+void gatha_game_expected_payoffs_prepare(GathaGame *g, proba_t **proba)
+{
+  if (g->expected_payoffs_prepare_func != NULL)
+    g->expected_payoffs_prepare_func(g, proba);
+}
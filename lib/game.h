@@ -8,6 +8,35 @@ struct _gatha_game {
   int n_strategies;
   void (*payoff_func)(GathaGame *g, int *actions,
 		      payoff_t *payoffs, int thread_id);
+
+  /** Computes the payoffs of `count' choices of strategies at once. profiles
+   * holds count*n_players strategies, one choice after the other, and payoffs
+   * receives count*n_players payoffs in the same order. Payoff functions that
+   * have a setup cost, or that vectorize well, should provide it. It is set
+   * by gatha_game_new to gatha_game_payoffs_batch_adapter, which calls
+   * `payoff_func' once per choice. It should be called through
+   * gatha_game_payoffs_batch. */
+  void (*payoff_batch_func)(GathaGame *g, const int *profiles, int count,
+			    payoff_t *payoffs, int thread_id);
+
+  /** Computes the exact expected payoff of each strategy of a player, when
+   * the other players follow their probability vectors, or NULL if the game
+   * cannot do it. The payoffs array receives n_strategies values. MCB and SFP
+   * use it instead of sampling when it is set. The gatha_game_from_* functions
+   * of the matrix backends set it; custom games can provide their own.
+   * \see gatha_game_expected_payoffs */
+  void (*expected_payoffs_func)(GathaGame *g, int player, proba_t **proba,
+				payoff_t *payoffs, int thread_id);
+
+  /** Prepares `expected_payoffs_func' for a set of probability vectors, or
+   * NULL. MCB and SFP call it from a single thread each time the vectors
+   * change, before their threads compute the expected payoffs of the
+   * players, so that games sharing work between the players (see
+   * gatha_anonymous_game_prepare) do it once, without locks. With NULL
+   * vectors, it forgets the last preparation: MCB and SFP do it at the end of
+   * a run, since they update their vectors in place.
+   * \see gatha_game_expected_payoffs_prepare */
+  void (*expected_payoffs_prepare_func)(GathaGame *g, proba_t **proba);
   void *data;
 } ;
 
@@ -15,10 +44,78 @@ extern GathaGame* gatha_game_new(int np, int ns);
 extern GathaGame* gatha_game_from_matrix(GathaPayoffMatrix *m);
 extern void gatha_game_free(GathaGame *g);
 
+/** Default `payoff_batch_func': calls `payoff_func' once for each choice of
+ * strategies. */
+extern void gatha_game_payoffs_batch_adapter(GathaGame *g, const int *profiles,
+					     int count, payoff_t *payoffs,
+					     int thread_id);
+
+/** Computes the payoffs of `count' choices of strategies, with
+ * `payoff_batch_func', or with `payoff_func' if the game has no batch callback.
+ * \see payoff_batch_func */
+extern void gatha_game_payoffs_batch(GathaGame *g, const int *profiles,
+				     int count, payoff_t *payoffs,
+				     int thread_id);
+
+/** Alignment of the rows of a probability vector, in bytes. */
+#define GATHA_PVECT_ALIGN 64
+
+/** Allocates a block aligned on GATHA_PVECT_ALIGN bytes, with its size
+ * rounded up to a multiple of it, so that blocks used by different threads
+ * never share a cache line. It is freed with free(). */
+extern void* gatha_aligned_malloc(size_t size);
+
+/** Creates a probability vector: one row of n_strategies probabilities per
+ * player. The rows live in a single GATHA_PVECT_ALIGN-aligned block, each
+ * padded with zeros to gatha_game_pvect_stride(g) entries, and proba[i]
+ * points to the row of player i. It is freed with gatha_game_pvect_free; the
+ * rows cannot be freed or replaced separately. */
 extern proba_t** gatha_game_pvect_new(GathaGame *g);
+
+/** Returns the number of entries between two rows of a probability vector:
+ * n_strategies rounded up to a multiple of GATHA_PVECT_ALIGN bytes. */
+extern int gatha_game_pvect_stride(GathaGame *g);
+
+/** Returns the block holding the rows of a probability vector, so that row i
+ * starts at gatha_game_pvect_block(g, proba) + i * gatha_game_pvect_stride(g).
+ */
+extern proba_t* gatha_game_pvect_block(GathaGame *g, proba_t **proba);
+
 extern void gatha_game_pvect_fprintf(GathaGame *g, proba_t **proba, FILE *f);
 extern void gatha_game_pvect_free(GathaGame *g, proba_t **proba);
 extern void gatha_game_pvect_normalize(GathaGame *g, proba_t **proba);
+
+/** Normalizes the probability vector of a single player, so that the players
+ * can be normalized in parallel. */
+extern void gatha_game_pvect_normalize_player(GathaGame *g, proba_t **proba,
+					      int player);
 extern void gatha_game_pvect_uniformize(GathaGame *g, proba_t **proba);
 
+/** Returns TRUE if gatha_game_expected_payoffs can compute exact expected
+ * payoffs for this game, ie. if it has an `expected_payoffs_func'. */
+extern boolean gatha_game_has_expected_payoffs(GathaGame *g);
+
+/** Computes the exact expected payoff of each strategy of a player, when the
+ * other players follow their probability vectors, using the
+ * `expected_payoffs_func' of the game.
+ * @param g The game
+ * @param player The player
+ * @param proba The probability vectors of the players
+ * @param[out] payoffs The n_strategies expected payoffs
+ * @param thread_id The thread calling the function
+ * @returns TRUE if the payoffs were computed, FALSE if the game does not
+ * support exact expectations.
+ */
+extern boolean gatha_game_expected_payoffs(GathaGame *g, int player,
+					   proba_t **proba, payoff_t *payoffs,
+					   int thread_id);
+
+/** Calls the `expected_payoffs_prepare_func' of the game, if any. It must not
+ * run while other threads compute expected payoffs.
+ * @param g The game
+ * @param proba The probability vectors of the players, or NULL to forget the
+ * last preparation
+ */
+extern void gatha_game_expected_payoffs_prepare(GathaGame *g, proba_t **proba);
+
 #endif /* _GATHA_GAME_H_ */
@@ -4,7 +4,16 @@
 #include "types.h"
 #include "game.h"
 #include "payoff_matrix.h"
+#include "symmetric_matrix.h"
+#include "sparse_matrix.h"
+#include "polymatrix_game.h"
+#include "anonymous_game.h"
+#include "payoff_cache.h"
+#include "payoff_store.h"
 #include "convergence.h"
+#include "simd.h"
+#include "rng.h"
+#include "sampler.h"
 
 /* algorithms for learning nash equilibria */
 #include "sastry.h"
@@ -1,4 +1,11 @@
 #include "mcb.h"
+#include "simd.h"
+#include "rng.h"
+#include "sampler.h"
+
+#include <omp.h>
+#include <math.h>
+#include <string.h>
 
 GathaMcbData* gatha_mcb_data_new(GathaGame *g)
 {
@@ -11,9 +18,16 @@ GathaMcbData* gatha_mcb_data_new(GathaGame *g)
 
   d->max_thread = 4;
   d->n_sim = 100;
+  d->sim_chunk = 25;
+  d->race_budget = 0;
+  d->race_confidence = 0.05;
+  d->common_profiles = FALSE;
+  d->exact_expectation = FALSE;
   d->b = 0.01;
   d->time = -1;
   d->max_time = -1;
+  d->proba_init = NULL;
+  d->seed = 1;
   d->checkpoint_dir = NULL;
   d->save_interval = 1000;
 
@@ -33,141 +47,312 @@ void gatha_mcb_data_free(GathaMcbData *d)
     free(d);
 }
 
-static inline void mcb_update_proba(int player, int action,
-				    payoff_t payoff,
-				    GathaMcbData *data)
+/* chooses the strategy of a player with the highest expected payoff */
+static inline int mcb_best_exact(GathaMcbData *data, int player,
+				 payoff_t *payoff_tmp, int thread_id)
 {
-  int i, m;
-  proba_t x;
-  proba_t *proba;
-  int c=0;
+  int i, n;
+  int best_action;
+  payoff_t best_payoff;
 
-  m = data->game->n_strategies;
-  proba = data->proba[player];
-	
-  /* check how many strategies have non-zero probability */
-  for(i=0 ; i<m ; i++) {
-    if((proba[i] > 0.0))
-      c++;
-  }
-  assert(c > 0);
-
-  if(c != 0) {
-    /* how much should we add to the probability of
-       choosing this action? */
-    x = (data->b * payoff * (1.0-proba[action]));
-    proba[action] += x;
-
-    /* remove that amount from the other probabilities */
-    x /= c;
-    for(i=0 ; i<m ; i++) {
-      if( i!=action &&  proba[i]>0.0) {
-	proba[i] = proba[i] - x;
-	if (proba[i] < 0.0) proba[i] = 0.0;
-      }
+  best_payoff = 0.0;
+  best_action = -1;
+  n = data->game->n_strategies;
+
+  gatha_game_expected_payoffs(data->game, player, data->proba,
+			      payoff_tmp, thread_id);
+  for(i=0 ; i<n ; i++) {
+    if (data->proba[player][i] == 0.0) continue;
+    if (payoff_tmp[i] > best_payoff || best_action == -1) {
+      best_action = i;
+      best_payoff = payoff_tmp[i];
     }
-  }		
+  }
+  assert(best_action != -1);
+  return best_action;
+}
 
+/* draws the strategies of the opponents of `player' for `count'
+   simulations, shared by all its strategies; the strategy of the player
+   itself is left to mcb_simulate */
+static void mcb_draw_common(GathaMcbData *data, GathaSampler *sampler,
+			    int player, int chunk, int count, int *common)
+{
+  int j, k, p;
+  GathaRng rng;
+
+  p = data->game->n_players;
+  gatha_rng_seed_stream(&rng, data->seed, data->time, player, chunk);
+  for(j=0 ; j<count ; j++) {
+    for(k=0 ; k<p ; k++) {
+      common[j * p + k] = (k == player) ? 0
+	: gatha_sampler_draw(sampler, k, &rng);
+    }
+  }
 }
 
-static inline int mcb_draw(GathaMcbData *data, int player)
+/* runs `count' simulations where `player' plays `strategy' and the others
+   draw theirs, or take them from `common' if it is not NULL, and returns the
+   sum of the payoffs of the player, and the sum of their squares in `sum_sq'
+   if it is not NULL. The simulations draw from their own generator, so that
+   they do not depend on the thread that runs them. */
+static inline payoff_t mcb_simulate(GathaMcbData *data, GathaSampler *sampler,
+				    int player, int strategy, int chunk,
+				    int count, const int *common,
+				    int *profiles, payoff_t *payoffs,
+				    payoff_t *sum_sq, int thread_id)
 {
-  proba_t result;
-  proba_t b_sup;
-  proba_t *T;
-  int i, n, c;
+  int j, k, p;
+  int *actions;
+  payoff_t sum, x;
+  GathaRng rng;
 
-  n = data->game->n_strategies;
-  T = data->proba[player];
-
-  // sometimes, due to rounding errors, the for loop
-  // below may fail to pick a strategy, so we try it
-  // 3 times.
-  c = 0;
-  while (c<3) {
-    result = (proba_t)rand()/RAND_MAX;
-
-    b_sup = T[0];
-    for(i=0;i<n;i++) {
-      if( result < b_sup ) {
-	return i;
+  p = data->game->n_players;
+  if (common != NULL) {
+    memcpy(profiles, common, (long) count * p * sizeof(int));
+    for(j=0 ; j<count ; j++) {
+      profiles[j * p + player] = strategy;
+    }
+  } else {
+    gatha_rng_seed_stream(&rng, data->seed, data->time,
+			  (uint64_t) player * data->game->n_strategies
+			  + strategy, chunk);
+    for(j=0 ; j<count ; j++) {
+      actions = profiles + j * p;
+      for(k=0 ; k<p ; k++) {
+	actions[k] = (k == player) ? strategy
+	  : gatha_sampler_draw(sampler, k, &rng);
       }
-      b_sup = b_sup + T[i+1];
     }
   }
+  gatha_game_payoffs_batch(data->game, profiles, count, payoffs, thread_id);
 
-  assert(FALSE);
-  return -1;
+  sum = 0.0;
+  for(j=0 ; j<count ; j++) {
+    sum += payoffs[j * p + player];
+  }
+  if (sum_sq != NULL) {
+    *sum_sq = 0.0;
+    for(j=0 ; j<count ; j++) {
+      x = payoffs[j * p + player];
+      *sum_sq += x * x;
+    }
+  }
+  return sum;
 }
 
-
-static inline int mcb_one_step(GathaMcbData *data, int player, int *actions, payoff_t *payoffs,
-			payoff_t *payoff_tmp, int thread_id)
+/* chooses the strategy of a player with the highest average payoff in the
+   simulations, from the sums of each chunk. They are added in the order of
+   the chunks, whichever thread computed them. */
+static inline int mcb_best_sampled(GathaMcbData *data, int player,
+				   const payoff_t *partial, int n_chunks)
 {
-  int i, j, k, p, n;
+  int i, c, n;
   int best_action;
   payoff_t best_payoff;
-  payoff_t sum, total;
-  proba_t rnd;
-  payoff_t incr;
+  payoff_t sum;
 
   best_payoff = 0.0;
   best_action = -1;
-  total = 0.0;
-
-  p = data->game->n_players;
   n = data->game->n_strategies;
-  for(i=0 ; i<n ; i++) {
-    if (data->proba[player][i] == 0.0) {
-      payoff_tmp[i] = 0.0;
-      continue;
-    }
-    actions[player] = i;
 
-    /* runs data->n_sim simulations for this action and computes
-       the average payoff */
+  for(i=0 ; i<n ; i++) {
+    if (data->proba[player][i] == 0.0) continue;
     sum = 0.0;
-    for(j=0 ; j<data->n_sim ; j++) {
-      for(k=0 ; k<p ; k++) {
-	if (k == player) continue;
-	actions[k] = mcb_draw(data, k);
-      }
-      data->game->payoff_func(data->game, actions, payoffs, thread_id);
-      //sum += log(1.0+payoffs[player]);
-      sum += payoffs[player];
+    for(c=0 ; c<n_chunks ; c++) {
+      sum += partial[((long) player * n + i) * n_chunks + c];
     }
     sum /= data->n_sim;
-    //costs_tmp[i] = 1.0/sum;
-    payoff_tmp[i] = sum;
-    total += payoff_tmp[i];
 
     if (sum > best_payoff || best_action == -1) {
-      best_action = actions[player];
+      best_action = i;
       best_payoff = sum;
     }
   }
 
   assert(best_action != -1);
   return best_action;
+}
+
+/* state of the race between the strategies of each player, during one
+   iteration. The strategies still in the race run `chunk' more simulations
+   in each round. */
+typedef struct {
+  /* work items of the round: player * m + strategy */
+  int *active;
+  int n_active;
+  /* sum of the payoffs, and of their squares, of each work item */
+  payoff_t *round_sum;
+  payoff_t *round_sq;
+  /* totals for each strategy of each player */
+  payoff_t *sum;
+  payoff_t *sq;
+  /* whether each strategy of each player is still in the race */
+  boolean *alive;
+  /* for each player: number of strategies in the race, simulations of each
+     of them, total number of simulations */
+  int *n_alive;
+  long *count;
+  long *used;
+  /* whether each player has work items in the round */
+  boolean *running;
+  /* index of the next round, used as the chunk of the generators */
+  int round;
+} McbRace;
+
+static McbRace* mcb_race_new(int n, int m)
+{
+  McbRace *r;
+
+  r = (McbRace*) malloc(sizeof(McbRace));
+  assert(r != NULL);
+  r->active = (int*) malloc((long) n * m * sizeof(int));
+  r->round_sum = (payoff_t*) malloc((long) n * m * sizeof(payoff_t));
+  r->round_sq = (payoff_t*) malloc((long) n * m * sizeof(payoff_t));
+  r->sum = (payoff_t*) malloc((long) n * m * sizeof(payoff_t));
+  r->sq = (payoff_t*) malloc((long) n * m * sizeof(payoff_t));
+  r->alive = (boolean*) malloc((long) n * m * sizeof(boolean));
+  r->n_alive = (int*) malloc(n * sizeof(int));
+  r->count = (long*) malloc(n * sizeof(long));
+  r->used = (long*) malloc(n * sizeof(long));
+  r->running = (boolean*) malloc(n * sizeof(boolean));
+  assert(r->active != NULL && r->round_sum != NULL && r->round_sq != NULL
+	 && r->sum != NULL && r->sq != NULL && r->alive != NULL
+	 && r->n_alive != NULL && r->count != NULL && r->used != NULL
+	 && r->running != NULL);
+  return r;
+}
+
+static void mcb_race_free(McbRace *r)
+{
+  free(r->active);
+  free(r->round_sum);
+  free(r->round_sq);
+  free(r->sum);
+  free(r->sq);
+  free(r->alive);
+  free(r->n_alive);
+  free(r->count);
+  free(r->used);
+  free(r->running);
+  free(r);
+}
+
+/* lists the work items of the next round: the strategies still in the race
+   of the players that can afford one more round. The first round is always
+   run. */
+static void mcb_race_schedule(GathaMcbData *data, McbRace *r, int chunk)
+{
+  int i, a, n, m;
+
+  n = data->game->n_players;
+  m = data->game->n_strategies;
+  r->n_active = 0;
+  for(i=0 ; i<n ; i++) {
+    r->running[i] = FALSE;
+    if (r->n_alive[i] < 2
+	|| (r->count[i] > 0
+	    && r->used[i] + (long) r->n_alive[i] * chunk > data->race_budget))
+      continue;
+    r->running[i] = TRUE;
+    for(a=0 ; a<m ; a++) {
+      if (r->alive[i * m + a]) r->active[r->n_active++] = i * m + a;
+    }
+  }
+}
+
+/* starts the race: every strategy that may be chosen enters it */
+static void mcb_race_start(GathaMcbData *data, McbRace *r, int chunk)
+{
+  int i, a, n, m;
+
+  n = data->game->n_players;
+  m = data->game->n_strategies;
+  for(i=0 ; i<n ; i++) {
+    r->n_alive[i] = 0;
+    r->count[i] = 0;
+    r->used[i] = 0;
+    for(a=0 ; a<m ; a++) {
+      r->alive[i * m + a] = (data->proba[i][a] != 0.0);
+      r->sum[i * m + a] = 0.0;
+      r->sq[i * m + a] = 0.0;
+      if (r->alive[i * m + a]) r->n_alive[i]++;
+    }
+  }
+  r->round = 0;
+  mcb_race_schedule(data, r, chunk);
+}
+
+/* adds the results of a round, in the order of the work items, and removes
+   from the race the strategies whose confidence interval is entirely below
+   that of the leader of their player */
+static void mcb_race_round(GathaMcbData *data, McbRace *r, int chunk)
+{
+  int i, a, t, n, m, leader;
+  long k;
+  payoff_t mean, var, z, *radius, low;
 
-  /* finds the 'best' solution, and increases its probability
-     to speed up the process */
-  payoff_t diff = payoff_tmp[best_action] * 9.0;
-  total += diff;
-  payoff_tmp[best_action] += diff;
+  n = data->game->n_players;
+  m = data->game->n_strategies;
+
+  for(t=0 ; t<r->n_active ; t++) {
+    r->sum[r->active[t]] += r->round_sum[t];
+    r->sq[r->active[t]] += r->round_sq[t];
+  }
+  for(t=0 ; t<r->n_active ; t++) {
+    i = r->active[t] / m;
+    if (t == 0 || r->active[t-1] / m != i) {
+      r->count[i] += chunk;
+      r->used[i] += (long) r->n_alive[i] * chunk;
+    }
+  }
 
-  /* picks a strategy with a probability proportional to its average payoff */
-  rnd = (proba_t)rand()/RAND_MAX;
-  rnd *= total;
-  incr = 0.0;
+  // a union bound over the strategies of a player; the sums of the round are
+  // no longer needed, and hold the radius of the confidence intervals
+  z = sqrt(2.0 * log(2.0 * m / data->race_confidence));
+  radius = r->round_sum;
   for(i=0 ; i<n ; i++) {
-    incr += payoff_tmp[i];
-    if (rnd < incr && !(data->proba[player][i] == 0.0)) {
-      return i;
+    k = r->count[i];
+    if (r->n_alive[i] < 2 || k < 2) continue;
+
+    leader = -1;
+    for(a=0 ; a<m ; a++) {
+      if (!r->alive[i * m + a]) continue;
+      mean = r->sum[i * m + a] / k;
+      var = (r->sq[i * m + a] - mean * r->sum[i * m + a]) / (k - 1);
+      radius[a] = z * sqrt((var > 0.0 ? var : 0.0) / k);
+      if (leader == -1 || mean > r->sum[i * m + leader] / k) leader = a;
+    }
+    low = r->sum[i * m + leader] / k - radius[leader];
+    for(a=0 ; a<m ; a++) {
+      if (!r->alive[i * m + a]) continue;
+      if (r->sum[i * m + a] / k + radius[a] < low) {
+	r->alive[i * m + a] = FALSE;
+	r->n_alive[i]--;
+      }
     }
   }
 
-  return -1;
+  r->round++;
+  mcb_race_schedule(data, r, chunk);
+}
+
+/* chooses the strategy of a player with the highest average payoff among
+   those still in the race */
+static inline int mcb_race_best(GathaMcbData *data, McbRace *r, int player)
+{
+  int a, m, best_action;
+
+  m = data->game->n_strategies;
+  best_action = -1;
+  for(a=0 ; a<m ; a++) {
+    if (!r->alive[player * m + a]) continue;
+    if (best_action == -1
+	|| r->sum[player * m + a] > r->sum[player * m + best_action])
+      best_action = a;
+  }
+  assert(best_action != -1);
+  return best_action;
 }
 
 #define FILENAME_MAX_LENGTH 256
@@ -228,12 +413,28 @@ void gatha_mcb(GathaMcbData *data)
   boolean stop;
   int thread_id;
 
-  /* payoff arrays, one for each thread */
-  payoff_t **payoffs_a;
-  /* payoff tmp arrays, one for each thread */
-  payoff_t **payoffs_tmp;
-  /* action arrays, one for each thread */
-  int **actions_a;
+  /* scratch arrays of a thread: strategy choices and payoffs of a
+     simulation batch, and payoffs of its strategies for a player */
+  int *profiles;
+  payoff_t *batch_payoffs;
+  payoff_t *payoff_tmp;
+  /* maximum number of simulations in a batch */
+  int batch;
+  /* work items: the simulations of a strategy of a player are split in
+     n_chunks chunks, and partial holds the sum of the payoffs of each */
+  long n_items, t;
+  int n_chunks, player, strategy, chunk;
+  payoff_t *partial;
+  /* alias tables of the players, used by the simulations */
+  GathaSampler *sampler;
+  boolean exact;
+  /* race between the strategies, if data->race_budget is set */
+  McbRace *race;
+  boolean racing;
+  /* opponents' strategies shared by all the strategies of each player, if
+     data->common_profiles is set: batch * n_chunks simulations per player */
+  int *common;
+  long common_size;
 
   assert(data != NULL);
   assert(data->game != NULL);
@@ -254,65 +455,190 @@ void gatha_mcb(GathaMcbData *data)
   payoffs = (payoff_t*) calloc(n, sizeof(payoff_t));
   assert(payoffs != NULL);
 
-  /* initialize the action and costs temp arrays used in the different
-     threads */
-  actions_a = (int**)malloc(data->max_thread*sizeof(int*));
-  payoffs_a = (payoff_t**)malloc(data->max_thread*sizeof(payoff_t*));
-  payoffs_tmp = (payoff_t**)malloc(data->max_thread*sizeof(payoff_t*));
-  for(i=0 ; i<data->max_thread ; i++) {
-    actions_a[i] = (int*)malloc(n*sizeof(int));
-    payoffs_a[i] = (payoff_t*)malloc(n*sizeof(payoff_t));
-    payoffs_tmp[i] = (payoff_t*)malloc(m*sizeof(payoff_t));
+  assert(data->max_thread > 0);
+  assert(data->n_sim > 0 && data->sim_chunk > 0);
+  sampler = gatha_sampler_new(data->game);
+  exact = data->exact_expectation &&
+    gatha_game_has_expected_payoffs(data->game);
+  racing = !exact && data->race_budget > 0;
+  if (racing) {
+    assert(data->race_confidence > 0.0 && data->race_confidence < 1.0);
+    batch = data->sim_chunk;
+    n_chunks = 0;
+    n_items = 0;
+    race = mcb_race_new(n, m);
+  } else {
+    batch = (data->sim_chunk < data->n_sim) ? data->sim_chunk : data->n_sim;
+    n_chunks = (data->n_sim + batch - 1) / batch;
+    n_items = (long) n * m * n_chunks;
+    race = NULL;
+  }
+  partial = (exact || racing) ? NULL
+    : (payoff_t*) malloc(n_items * sizeof(payoff_t));
+  common_size = (long) batch * (racing ? 1 : n_chunks) * n;
+  common = NULL;
+  if (!exact && data->common_profiles) {
+    common = (int*) gatha_aligned_malloc(n * common_size * sizeof(int));
+    assert(common != NULL);
   }
 
   data->time = 0;
   stop = FALSE;
-  while (stop == FALSE && (data->max_time == -1 ||
-			   data->time < data->max_time)
-	 )
-    {
-      if (data->time % data->save_interval == 0 && data->checkpoint_dir != NULL) {
-	mcb_save_checkpoint(data, actions, payoffs);
-      }
-
-      if (data->feedback_func != NULL && data->time % data->feedback_interval == 0) {
-	data->feedback_func(data, actions, payoffs, data->feedback_data);
-      }
-
-      #pragma omp parallel for private(thread_id)
-      for(i=0 ; i<n ; i++) {
-	thread_id = omp_get_thread_num();
-	actions[i] = mcb_one_step(data, i, actions_a[thread_id],
-				  payoffs_a[thread_id],
-				  payoffs_tmp[thread_id],
-				  thread_id);
-      }
-      
-      data->game->payoff_func(data->game, actions, payoffs, 0);
-      
-      for(i=0 ; i<n ; i++) {
-	mcb_update_proba(i, actions[i], payoffs[i], data);
-      }
-      gatha_game_pvect_normalize(data->game, data->proba);
 
-      if (data->convergence_func != NULL) {
-	stop = data->convergence_func(payoffs,
-				      data->convergence_data);
+  /* the threads live for the whole run: the serial steps are done by one of
+     them while the others wait at the barrier that ends them */
+  #pragma omp parallel num_threads(data->max_thread) \
+    private(thread_id, i, t, player, strategy, chunk, \
+	    profiles, batch_payoffs, payoff_tmp)
+  {
+    thread_id = omp_get_thread_num();
+
+    /* each thread allocates its own scratch arrays, so that they are near
+       it and do not share cache lines with those of the others */
+    profiles = (int*) gatha_aligned_malloc(batch * n * sizeof(int));
+    batch_payoffs = (payoff_t*) gatha_aligned_malloc(batch * n
+						     * sizeof(payoff_t));
+    payoff_tmp = (payoff_t*) gatha_aligned_malloc(m * sizeof(payoff_t));
+    assert(profiles != NULL && batch_payoffs != NULL && payoff_tmp != NULL);
+
+    while (stop == FALSE && (data->max_time == -1 ||
+			     data->time < data->max_time)
+	   )
+      {
+	#pragma omp single
+	{
+	  /* the probability vectors changed in the last update, and do not
+	     change again until the next one: the expected payoffs share the
+	     same preparation, even those computed by the callbacks */
+	  if (exact)
+	    gatha_game_expected_payoffs_prepare(data->game, data->proba);
+
+	  if (data->time % data->save_interval == 0 && data->checkpoint_dir != NULL) {
+	    mcb_save_checkpoint(data, actions, payoffs);
+	  }
+
+	  if (data->feedback_func != NULL && data->time % data->feedback_interval == 0) {
+	    data->feedback_func(data, actions, payoffs, data->feedback_data);
+	  }
+
+	  /* all the simulations of this iteration draw from the same tables */
+	  if (!exact) gatha_sampler_build(sampler, data->proba);
+	}
+
+	if (exact) {
+	  #pragma omp for
+	  for(i=0 ; i<n ; i++) {
+	    actions[i] = mcb_best_exact(data, i, payoff_tmp, thread_id);
+	  }
+	} else if (racing) {
+	  #pragma omp single
+	  mcb_race_start(data, race, batch);
+
+	  /* the round of each work item gives its generator, so the race does
+	     not depend on the threads either */
+	  while (race->n_active > 0) {
+	    if (common != NULL) {
+	      #pragma omp for schedule(dynamic)
+	      for(i=0 ; i<n ; i++) {
+		if (race->running[i])
+		  mcb_draw_common(data, sampler, i, race->round, batch,
+				  common + i * common_size);
+	      }
+	    }
+
+	    #pragma omp for schedule(dynamic)
+	    for(t=0 ; t<race->n_active ; t++) {
+	      player = race->active[t] / m;
+	      strategy = race->active[t] % m;
+	      race->round_sum[t] =
+		mcb_simulate(data, sampler, player, strategy, race->round,
+			     batch, (common != NULL) ?
+			     common + player * common_size : NULL,
+			     profiles, batch_payoffs, &(race->round_sq[t]),
+			     thread_id);
+	    }
+
+	    #pragma omp single
+	    mcb_race_round(data, race, batch);
+	  }
+
+	  #pragma omp for
+	  for(i=0 ; i<n ; i++) {
+	    actions[i] = mcb_race_best(data, race, i);
+	  }
+	} else {
+	  /* the (player, strategy, chunk) work items are spread over all the
+	     threads, even when there are only a few players */
+	  if (common != NULL) {
+	    #pragma omp for schedule(dynamic)
+	    for(t=0 ; t<(long) n * n_chunks ; t++) {
+	      player = t / n_chunks;
+	      chunk = t % n_chunks;
+	      mcb_draw_common(data, sampler, player, chunk,
+			      (chunk < n_chunks - 1) ? batch
+			      : data->n_sim - chunk * batch,
+			      common + player * common_size
+			      + (long) chunk * batch * n);
+	    }
+	  }
+
+	  #pragma omp for schedule(dynamic)
+	  for(t=0 ; t<n_items ; t++) {
+	    player = t / ((long) m * n_chunks);
+	    strategy = (t / n_chunks) % m;
+	    chunk = t % n_chunks;
+	    if (data->proba[player][strategy] == 0.0) {
+	      partial[t] = 0.0;
+	      continue;
+	    }
+	    partial[t] = mcb_simulate(data, sampler, player, strategy, chunk,
+				      (chunk < n_chunks - 1) ? batch
+				      : data->n_sim - chunk * batch,
+				      (common != NULL) ? common
+				      + player * common_size
+				      + (long) chunk * batch * n : NULL,
+				      profiles, batch_payoffs, NULL, thread_id);
+	  }
+
+	  #pragma omp for
+	  for(i=0 ; i<n ; i++) {
+	    actions[i] = mcb_best_sampled(data, i, partial, n_chunks);
+	  }
+	}
+
+	#pragma omp single
+	{
+	  data->game->payoff_func(data->game, actions, payoffs, thread_id);
+
+	  /* the update does not change the payoffs, so the convergence can be
+	     checked first */
+	  if (data->convergence_func != NULL) {
+	    stop = data->convergence_func(payoffs,
+					  data->convergence_data);
+	  }
+	  data->time++;
+	}
+
+	#pragma omp for
+	for(i=0 ; i<n ; i++) {
+	  gatha_simd_lri_update(data->proba[i], m, actions[i],
+				data->b * payoffs[i]);
+	}
       }
 
-
-      data->time++;
-    }
+    free(profiles);
+    free(batch_payoffs);
+    free(payoff_tmp);
+  }
 
   /* free the temp arrays we created */
-  for(i=0 ; i<data->max_thread ; i++) {
-    free(actions_a[i]);
-    free(payoffs_a[i]);
-    free(payoffs_tmp[i]);
-  }
-  free(actions_a);
-  free(payoffs_a);
-  free(payoffs_tmp);
+  /* the last update changed the vectors after the last preparation */
+  if (exact) gatha_game_expected_payoffs_prepare(data->game, NULL);
+
+  gatha_sampler_free(sampler);
+  if (race != NULL) mcb_race_free(race);
+  free(common);
+  free(partial);
   free(actions);
   free(payoffs);
 }
@@ -32,6 +32,13 @@ struct _gatha_mcb_data {
    * `gatha_mcb' will initialize the vector with uniform probability. */
   void (*proba_init)(GathaGame* g, proba_t **p);
 
+  /** Seed of the random number generators used to draw the strategies of
+   * the simulations. Each chunk of simulations of a strategy of a player,
+   * at a given iteration, uses a generator derived from the seed and these
+   * numbers, so that a run gives the same results whatever the number of
+   * threads and the order in which they run. */
+  unsigned long seed;
+
   char* checkpoint_dir;
   int save_interval;
 
@@ -46,7 +53,49 @@ struct _gatha_mcb_data {
   /** Number of simulations each player does when it chooses its strategy. */
   int n_sim;
 
-  /** Maximum number of threads to start */
+  /** Number of simulations in a work item. The simulations of each strategy
+   * of each player are split in chunks of `sim_chunk', and the chunks of all
+   * the players are spread over the threads, so that even a 2-player game
+   * keeps them busy. Smaller chunks balance the work better, larger ones
+   * make bigger batches for GathaGame::payoff_batch_func. The results
+   * depend on it, but not on the number of threads. */
+  int sim_chunk;
+
+  /** If positive, the players race their strategies instead of running
+   * `n_sim' simulations of each: in each round, the strategies still in the
+   * race run `sim_chunk' more simulations, and those whose confidence
+   * interval falls below that of the leader are dropped. A player stops when
+   * a single strategy is left, or when the next round would take it over
+   * `race_budget' simulations, and plays the best remaining strategy. With
+   * many strategies, most are dropped after a few rounds. 0 (no race) by
+   * default. */
+  int race_budget;
+
+  /** Probability that the race drops the best strategy of a player, 0.05 by
+   * default. Smaller values make wider confidence intervals, and longer
+   * races. */
+  double race_confidence;
+
+  /** If TRUE, the strategies of the opponents of a player are drawn once
+   * per iteration (or per round of a race), and all the strategies of the
+   * player are tried against the same ones. The differences between the
+   * strategies then vary much less than their payoffs, so fewer simulations
+   * pick the best one, and the opponents are drawn m times less often.
+   * FALSE by default. */
+  boolean common_profiles;
+
+  /** If TRUE, and if the game can compute exact expected payoffs (see
+   * GathaGame::expected_payoffs_func), the players use the expected payoff of
+   * their strategies instead of running `n_sim' simulations. This changes the
+   * dynamics of the algorithm, so it is FALSE by default. */
+  boolean exact_expectation;
+
+  /** Maximum number of threads to start, 4 by default. `gatha_mcb' runs with
+   * at most this many threads, so the thread ids given to the payoff
+   * callbacks are lower (see gatha_payoff_cache_new). Each thread allocates
+   * its own scratch arrays. Where the threads run is set with the usual
+   * OpenMP variables, for example OMP_PROC_BIND=close and OMP_PLACES=cores.
+   */
   int max_thread;
 
   /** Feedback interval */
@@ -0,0 +1,224 @@
+#include "payoff_cache.h"
+#include "game.h"
+
+#include <string.h>
+
+static GathaPayoffCacheShard* payoff_cache_shard_new(int n_players, long capacity)
+{
+  GathaPayoffCacheShard *s;
+
+  // aligned and padded, so that the counters of two shards never share a
+  // cache line
+  s = (GathaPayoffCacheShard*)
+    gatha_aligned_malloc(sizeof(GathaPayoffCacheShard));
+  assert(s != NULL);
+
+  // at least as many buckets as entries, so that chains stay short
+  s->n_buckets = 1;
+  while (s->n_buckets < capacity) s->n_buckets *= 2;
+  s->buckets = (long*) malloc(s->n_buckets * sizeof(long));
+  s->next = (long*) malloc(capacity * sizeof(long));
+  s->keys = (int*) malloc(capacity * n_players * sizeof(int));
+  s->payoffs = (payoff_t*) malloc(capacity * n_players * sizeof(payoff_t));
+  s->referenced = (unsigned char*) malloc(capacity * sizeof(unsigned char));
+  assert(s->buckets != NULL && s->next != NULL && s->keys != NULL
+	 && s->payoffs != NULL && s->referenced != NULL);
+
+  return s;
+}
+
+static void payoff_cache_shard_clear(GathaPayoffCacheShard *s)
+{
+  long i;
+
+  for(i=0 ; i<s->n_buckets ; i++) {
+    s->buckets[i] = -1;
+  }
+  s->size = 0;
+  s->hand = 0;
+  s->hits = 0;
+  s->misses = 0;
+}
+
+static void payoff_cache_shard_free(GathaPayoffCacheShard *s)
+{
+  free(s->buckets);
+  free(s->next);
+  free(s->keys);
+  free(s->payoffs);
+  free(s->referenced);
+  free(s);
+}
+
+GathaPayoffCache* gatha_payoff_cache_new(GathaGame *g, int n_shards,
+					 long capacity)
+{
+  GathaPayoffCache *c;
+  int i;
+
+  assert(g != NULL && g->payoff_func != NULL);
+  assert(n_shards > 0 && capacity > 0);
+
+  c = (GathaPayoffCache*) malloc(sizeof(GathaPayoffCache));
+  if (c == NULL) return NULL;
+
+  c->game = g;
+  c->n_shards = n_shards;
+  c->capacity = capacity;
+  c->shards = (GathaPayoffCacheShard**) malloc(n_shards
+					      * sizeof(GathaPayoffCacheShard*));
+  assert(c->shards != NULL);
+  for(i=0 ; i<n_shards ; i++) {
+    c->shards[i] = payoff_cache_shard_new(g->n_players, capacity);
+    payoff_cache_shard_clear(c->shards[i]);
+  }
+
+  return c;
+}
+
+void gatha_payoff_cache_free(GathaPayoffCache *c)
+{
+  int i;
+
+  assert(c != NULL);
+  for(i=0 ; i<c->n_shards ; i++) {
+    payoff_cache_shard_free(c->shards[i]);
+  }
+  free(c->shards);
+  free(c);
+}
+
+static void payoff_cache_expected_payoffs(GathaGame *g, int player,
+					  proba_t **proba, payoff_t *payoffs,
+					  int thread_id)
+{
+  GathaPayoffCache *c;
+
+  c = (GathaPayoffCache*) g->data;
+  c->game->expected_payoffs_func(c->game, player, proba, payoffs, thread_id);
+}
+
+static void payoff_cache_expected_payoffs_prepare(GathaGame *g, proba_t **proba)
+{
+  GathaPayoffCache *c;
+
+  c = (GathaPayoffCache*) g->data;
+  gatha_game_expected_payoffs_prepare(c->game, proba);
+}
+
+GathaGame* gatha_game_from_payoff_cache(GathaPayoffCache *c)
+{
+  GathaGame *g;
+  assert(c != NULL);
+  g = gatha_game_new(c->game->n_players, c->game->n_strategies);
+  g->payoff_func = gatha_payoff_cache_payoffs;
+  if (c->game->expected_payoffs_func != NULL)
+    g->expected_payoffs_func = payoff_cache_expected_payoffs;
+  g->expected_payoffs_prepare_func = payoff_cache_expected_payoffs_prepare;
+  g->data = c;
+  return g;
+}
+
+static inline long payoff_cache_hash(const int *actions, int n)
+{
+  int i;
+  unsigned long h;
+
+  // FNV-1a over the strategies
+  h = 2166136261UL;
+  for(i=0 ; i<n ; i++) {
+    h = (h ^ (unsigned long) actions[i]) * 16777619UL;
+  }
+  return (long) (h ^ (h >> 17));
+}
+
+/* removes the entry under the clock hand that was not referenced since the
+   hand last passed it, and returns it */
+static long payoff_cache_evict(GathaPayoffCacheShard *s, int n, long capacity)
+{
+  long e, *p;
+
+  while (s->referenced[s->hand]) {
+    s->referenced[s->hand] = 0;
+    s->hand = (s->hand + 1) % capacity;
+  }
+  e = s->hand;
+  s->hand = (s->hand + 1) % capacity;
+
+  // unlink it from its bucket
+  p = &(s->buckets[payoff_cache_hash(s->keys + e * n, n) & (s->n_buckets - 1)]);
+  while (*p != e) p = &(s->next[*p]);
+  *p = s->next[e];
+  return e;
+}
+
+void gatha_payoff_cache_payoffs(GathaGame *g, int *actions,
+				payoff_t *payoffs, int thread_id)
+{
+  GathaPayoffCache *c;
+  GathaPayoffCacheShard *s;
+  int n;
+  long b, e;
+
+  c = (GathaPayoffCache*) g->data;
+  assert(thread_id >= 0 && thread_id < c->n_shards);
+  s = c->shards[thread_id];
+  n = g->n_players;
+
+  b = payoff_cache_hash(actions, n) & (s->n_buckets - 1);
+  for(e=s->buckets[b] ; e!=-1 ; e=s->next[e]) {
+    if (memcmp(s->keys + e * n, actions, n * sizeof(int)) == 0) {
+      s->referenced[e] = 1;
+      s->hits++;
+      memcpy(payoffs, s->payoffs + e * n, n * sizeof(payoff_t));
+      return;
+    }
+  }
+
+  s->misses++;
+  c->game->payoff_func(c->game, actions, payoffs, thread_id);
+
+  if (s->size < c->capacity) {
+    e = s->size++;
+  } else {
+    e = payoff_cache_evict(s, n, c->capacity);
+  }
+  memcpy(s->keys + e * n, actions, n * sizeof(int));
+  memcpy(s->payoffs + e * n, payoffs, n * sizeof(payoff_t));
+  s->referenced[e] = 1;
+  s->next[e] = s->buckets[b];
+  s->buckets[b] = e;
+}
+
+void gatha_payoff_cache_clear(GathaPayoffCache *c)
+{
+  int i;
+
+  for(i=0 ; i<c->n_shards ; i++) {
+    payoff_cache_shard_clear(c->shards[i]);
+  }
+}
+
+long gatha_payoff_cache_hits(GathaPayoffCache *c)
+{
+  int i;
+  long n;
+
+  n = 0;
+  for(i=0 ; i<c->n_shards ; i++) {
+    n += c->shards[i]->hits;
+  }
+  return n;
+}
+
+long gatha_payoff_cache_misses(GathaPayoffCache *c)
+{
+  int i;
+  long n;
+
+  n = 0;
+  for(i=0 ; i<c->n_shards ; i++) {
+    n += c->shards[i]->misses;
+  }
+  return n;
+}
@@ -0,0 +1,93 @@
+#ifndef _GATHA_PAYOFF_CACHE_H_
+#define _GATHA_PAYOFF_CACHE_H_
+
+#include "types.h"
+
+/** Part of a GathaPayoffCache used by a single thread. The entries are
+ * chained in hash buckets, and evicted with the CLOCK algorithm: an
+ * approximation of LRU that only needs one bit per entry. */
+typedef struct _gatha_payoff_cache_shard {
+  /** Number of entries in use. */
+  long size;
+
+  /** Number of buckets, a power of two. */
+  long n_buckets;
+
+  /** First entry of each bucket, or -1. */
+  long *buckets;
+
+  /** Next entry in the same bucket, or -1. */
+  long *next;
+
+  /** Strategy choices of the entries, n_players values each. */
+  int *keys;
+
+  /** Payoffs of the entries, n_players values each. */
+  payoff_t *payoffs;
+
+  /** Set when an entry is read, cleared when the clock hand passes it. */
+  unsigned char *referenced;
+
+  /** Position of the clock hand. */
+  long hand;
+
+  /** Number of lookups that found an entry. */
+  long hits;
+
+  /** Number of lookups that called the cached game. */
+  long misses;
+} GathaPayoffCacheShard;
+
+/** Memoizes the payoffs of a game whose payoff function is expensive, for
+ *  example a simulation. Each thread has its own shard, selected by the
+ *  thread_id argument of the payoff callback, so that threads never wait
+ *  for each other. Shards have a bounded number of entries. */
+struct _gatha_payoff_cache {
+  /** The game whose payoffs are cached. */
+  GathaGame *game;
+
+  /** Number of shards: thread ids must be lower. */
+  int n_shards;
+
+  /** Maximum number of entries of each shard. */
+  long capacity;
+
+  /** The shards, allocated separately with gatha_aligned_malloc so that their
+   * counters do not share cache lines. */
+  GathaPayoffCacheShard **shards;
+} ;
+
+/** Creates a GathaPayoffCache.
+ * @param g The game whose payoffs are cached
+ * @param n_shards Number of shards, ie. the maximum number of threads,
+ * for example GathaMcbData::max_thread
+ * @param capacity Maximum number of entries of each shard
+ */
+extern GathaPayoffCache* gatha_payoff_cache_new(GathaGame *g, int n_shards,
+						long capacity);
+
+/** Frees a GathaPayoffCache. The cached game is not freed. */
+extern void gatha_payoff_cache_free(GathaPayoffCache *c);
+
+/** Creates a game using a cache for computing the payoffs. It can replace
+ * the cached game anywhere; it has the same expected payoffs hooks.
+ */
+extern GathaGame* gatha_game_from_payoff_cache(GathaPayoffCache *c);
+
+/** Retrieves the players' payoffs for a choice of strategies, from the shard
+ * of thread_id, calling the payoff function of the cached game on a miss.
+ * This is the payoff callback used by gatha_game_from_payoff_cache.
+ */
+extern void gatha_payoff_cache_payoffs(GathaGame *g, int *actions,
+				       payoff_t *payoffs, int thread_id);
+
+/** Removes all the entries, and resets the counters. */
+extern void gatha_payoff_cache_clear(GathaPayoffCache *c);
+
+/** Returns the number of lookups that found an entry, in all the shards. */
+extern long gatha_payoff_cache_hits(GathaPayoffCache *c);
+
+/** Returns the number of lookups that did not find an entry, in all the shards. */
+extern long gatha_payoff_cache_misses(GathaPayoffCache *c);
+
+#endif /* _GATHA_PAYOFF_CACHE_H_ */
@@ -1,13 +1,101 @@
 #include "payoff_matrix.h"
 #include "game.h"
+#include "simd.h"
 
-#include <math.h>
 #include <string.h>
+#include <limits.h>
+
+/* fills `strides' for the per-player layout: the player's own strategy
+   changes first, then the other players' strategies in order */
+static void payoff_matrix_own_strides(int p, int s, long *strides)
+{
+  int i, k;
+  long n;
+
+  for(i=0 ; i<p ; i++) {
+    strides[i*p + i] = 1;
+    n = s;
+    for(k=0 ; k<p ; k++) {
+      if (k == i) continue;
+      strides[i*p + k] = n;
+      n *= s;
+    }
+  }
+}
+
+/* rounds a payoff to the nearest level of GATHA_PAYOFF_INT16 */
+static inline int16_t payoff_matrix_quantize(GathaPayoffMatrix *m, payoff_t value)
+{
+  payoff_t x;
+  long q;
+
+  x = (value - m->offset) / m->scale;
+  if (x > -32767.5 && x < 32767.5) {
+    q = (x >= 0) ? (long) (x + 0.5) : -(long) (0.5 - x);
+    return (int16_t) q;
+  }
+
+  // the value is outside of the range given when the matrix was created
+  if (m->n_clamped++ == 0) {
+    fprintf(stderr, "payoff %g outside of [%g, %g], clamped\n", value,
+	    m->offset - 32767 * m->scale, m->offset + 32767 * m->scale);
+  }
+  return (x > 0) ? 32767 : -32767;
+}
+
+/* reads the element `p' of the payoffs array, whatever its precision */
+static inline payoff_t payoff_matrix_read(GathaPayoffMatrix *m, long p)
+{
+  switch(m->precision) {
+  case GATHA_PAYOFF_FLOAT:
+    return m->payoffs_float[p];
+  case GATHA_PAYOFF_INT16:
+    return m->offset + m->scale * m->payoffs_int16[p];
+  default:
+    return m->payoffs[p];
+  }
+}
+
+/* writes the element `p' of the payoffs array, and returns the value actually
+   stored */
+static inline payoff_t payoff_matrix_write(GathaPayoffMatrix *m, long p,
+					   payoff_t value)
+{
+  switch(m->precision) {
+  case GATHA_PAYOFF_FLOAT:
+    m->payoffs_float[p] = (float) value;
+    break;
+  case GATHA_PAYOFF_INT16:
+    m->payoffs_int16[p] = payoff_matrix_quantize(m, value);
+    break;
+  default:
+    m->payoffs[p] = value;
+    return value;
+  }
+  return payoff_matrix_read(m, p);
+}
 
 GathaPayoffMatrix* gatha_payoff_matrix_new(int p, int s)
+{
+  return gatha_payoff_matrix_new_with_layout(p, s, GATHA_PAYOFF_LAYOUT_INTERLEAVED);
+}
+
+GathaPayoffMatrix* gatha_payoff_matrix_new_with_layout(int p, int s,
+						       GathaPayoffLayout layout)
+{
+  return gatha_payoff_matrix_new_with_precision(p, s, layout,
+						GATHA_PAYOFF_DOUBLE, 0, 0);
+}
+
+GathaPayoffMatrix* gatha_payoff_matrix_new_with_precision(int p, int s,
+							  GathaPayoffLayout layout,
+							  GathaPayoffPrecision precision,
+							  payoff_t min, payoff_t max)
 {
   GathaPayoffMatrix *m;
   long n;
+  int i, k;
+  int16_t q;
 
   assert(p > 1 && s > 0);
 
@@ -16,37 +104,207 @@ GathaPayoffMatrix* gatha_payoff_matrix_new(int p, int s)
 
   m->n_players = p;
   m->n_strategies = s;
+  m->layout = layout;
+  m->precision = precision;
+
+  // number of choices of strategies; larger games need a GathaSparseMatrix
+  n = 1;
+  for(i=0 ; i<p ; i++) {
+    assert(n <= LONG_MAX / s);
+    n *= s;
+  }
+  assert(n <= LONG_MAX / p);
+  m->size = n * p;
 
-  n = pow(s, p+1);
-  assert(n > 0);
-  m->payoffs = (payoff_t*) calloc(n, sizeof(payoff_t));
-  assert(m->payoffs != NULL);
+  m->offsets = (long*) malloc(p * sizeof(long));
+  m->strides = (long*) malloc(p * p * sizeof(long));
+  m->player_strides = (long*) malloc(p * p * sizeof(long));
+  assert(m->offsets != NULL && m->strides != NULL && m->player_strides != NULL);
+  payoff_matrix_own_strides(p, s, m->player_strides);
+
+  m->payoffs = NULL;
+  m->payoffs_float = NULL;
+  m->payoffs_int16 = NULL;
+  m->scale = 1.0;
+  m->offset = 0.0;
+  m->n_clamped = 0;
+  switch(precision) {
+  case GATHA_PAYOFF_FLOAT:
+    m->payoffs_float = (float*) calloc(m->size, sizeof(float));
+    assert(m->payoffs_float != NULL);
+    break;
+  case GATHA_PAYOFF_INT16:
+    // [min, max] is mapped to [-32767, 32767]
+    assert(max >= min);
+    if (max > min) m->scale = (max - min) / 65534.0;
+    m->offset = (max + min) / 2.0;
+    m->payoffs_int16 = (int16_t*) malloc(m->size * sizeof(int16_t));
+    assert(m->payoffs_int16 != NULL);
+    break;
+  default:
+    m->payoffs = (payoff_t*) calloc(m->size, sizeof(payoff_t));
+    assert(m->payoffs != NULL);
+  }
 
+  m->player_payoffs = NULL;
+  if (layout == GATHA_PAYOFF_LAYOUT_PER_PLAYER) {
+    // one tensor after the other
+    for(i=0 ; i<p ; i++) {
+      m->offsets[i] = i * n;
+    }
+    memcpy(m->strides, m->player_strides, p * p * sizeof(long));
+    if (precision == GATHA_PAYOFF_DOUBLE) {
+      m->player_payoffs = (payoff_t**) malloc(p * sizeof(payoff_t*));
+      assert(m->player_payoffs != NULL);
+      for(i=0 ; i<p ; i++) {
+	m->player_payoffs[i] = m->payoffs + m->offsets[i];
+      }
+    }
+  } else {
+    /* the payoffs of a choice of strategies are stored next to each other,
+       so the first player's strategy moves by p elements, the second one's
+       by p*s elements, and so on */
+    for(i=0 ; i<p ; i++) {
+      m->offsets[i] = i;
+      n = p;
+      for(k=0 ; k<p ; k++) {
+	m->strides[i*p + k] = n;
+	n *= s;
+      }
+    }
+  }
+
+  // all the payoffs start with the same value
   m->max_payoff = 0;
+  m->max_payoff_count = m->size;
+  if (precision == GATHA_PAYOFF_INT16) {
+    // the payoffs start at 0, or at the nearest value of the range
+    q = payoff_matrix_quantize(m, (min > 0) ? min : (max < 0) ? max : 0);
+    for(n=0 ; n<m->size ; n++) {
+      m->payoffs_int16[n] = q;
+    }
+    m->max_payoff = m->offset + m->scale * q;
+  }
 
   return m;
 }
 
 void gatha_payoff_matrix_free(GathaPayoffMatrix *m)
 {
+  int i;
+
   assert(m != NULL);
-  assert(m->payoffs != NULL);
+  if (m->player_payoffs != NULL) {
+    if (m->layout == GATHA_PAYOFF_LAYOUT_INTERLEAVED) {
+      for(i=0 ; i<m->n_players ; i++) {
+	free(m->player_payoffs[i]);
+      }
+    }
+    free(m->player_payoffs);
+  }
   free(m->payoffs);
+  free(m->payoffs_float);
+  free(m->payoffs_int16);
+  free(m->offsets);
+  free(m->strides);
+  free(m->player_strides);
   free(m);
 }
 
-void gatha_payoff_matrix_compute_max_payoff(GathaPayoffMatrix *m)
+/* index of the payoff of a player for a choice of strategies */
+static inline long payoff_matrix_index(GathaPayoffMatrix *m, int player,
+				       const int *actions)
 {
   int i, n;
-  n = pow(m->n_strategies, m->n_players+1);
+  long p;
+  const long *strides;
+
+  n = m->n_players;
+  strides = m->strides + player * n;
+  p = m->offsets[player];
   for(i=0 ; i<n ; i++) {
-    if (m->max_payoff < m->payoffs[i])
-      m->max_payoff = m->payoffs[i];
+    p += actions[i] * strides[i];
   }
+  return p;
+}
+
+/* index of the payoff of a player in its own tensor of `player_payoffs' */
+static inline long payoff_matrix_player_index(GathaPayoffMatrix *m, int player,
+					      const int *actions)
+{
+  int i, n;
+  long p;
+  const long *strides;
+
+  n = m->n_players;
+  strides = m->player_strides + player * n;
+  p = 0;
+  for(i=0 ; i<n ; i++) {
+    p += actions[i] * strides[i];
+  }
+  return p;
+}
+
+/* keeps track of the maximum payoff when `old' is replaced by `value' */
+static inline void payoff_matrix_update_max(GathaPayoffMatrix *m, payoff_t old,
+					    payoff_t value)
+{
+  if (value > m->max_payoff) {
+    m->max_payoff = value;
+    m->max_payoff_count = 1;
+  } else if (value == m->max_payoff) {
+    if (old != m->max_payoff) m->max_payoff_count++;
+  } else if (old == m->max_payoff && --m->max_payoff_count == 0) {
+    // the last copy of the maximum was overwritten
+    gatha_payoff_matrix_compute_max_payoff(m);
+  }
+}
+
+/* sets a payoff, and keeps the per-player copy up to date */
+static inline void payoff_matrix_store(GathaPayoffMatrix *m, int player,
+				       const int *actions, payoff_t value)
+{
+  long p;
+  payoff_t old;
+
+  p = payoff_matrix_index(m, player, actions);
+  old = payoff_matrix_read(m, p);
+  value = payoff_matrix_write(m, p, value);
+  payoff_matrix_update_max(m, old, value);
+  if (m->layout == GATHA_PAYOFF_LAYOUT_INTERLEAVED && m->player_payoffs != NULL) {
+    m->player_payoffs[player][payoff_matrix_player_index(m, player, actions)] = value;
+  }
+}
+
+void gatha_payoff_matrix_compute_max_payoff(GathaPayoffMatrix *m)
+{
+  long i, count;
+  payoff_t max, x;
+
+  max = payoff_matrix_read(m, 0);
+  count = 1;
+  for(i=1 ; i<m->size ; i++) {
+    x = payoff_matrix_read(m, i);
+    if (x > max) {
+      max = x;
+      count = 1;
+    } else if (x == max) {
+      count++;
+    }
+  }
+  m->max_payoff = max;
+  m->max_payoff_count = count;
+}
+
+payoff_t gatha_payoff_matrix_max_payoff(GathaPayoffMatrix *m)
+{
+  return m->max_payoff;
 }
 
 void gatha_payoff_matrix_fprintf(GathaPayoffMatrix *m, FILE *f) {
-  int r, c, v;
+  int r, c, v, i;
+  long p, n;
+  int *actions;
   fprintf(f, "%d players, %d strategies\n", m->n_players, m->n_strategies);
   if (m->n_players == 2) {
     for(r=0 ; r<m->n_strategies ; r++) {
@@ -58,6 +316,26 @@ void gatha_payoff_matrix_fprintf(GathaPayoffMatrix *m, FILE *f) {
       }
       fprintf(f, "\n");
     }
+  } else {
+    // one line per choice of strategies, the first player's
+    // strategy changing first
+    actions = (int*) calloc(m->n_players, sizeof(int));
+    assert(actions != NULL);
+    n = m->size / m->n_players;
+    for(p=0 ; p<n ; p++) {
+      for(i=0 ; i<m->n_players ; i++) {
+	fprintf(f, "%d ", actions[i]);
+      }
+      fprintf(f, ":");
+      for(v=0 ; v<m->n_players ; v++) {
+	fprintf(f, " %f", gatha_payoff_matrix_get_v(m, v, actions));
+      }
+      fprintf(f, "\n");
+      for(i=0 ; i<m->n_players && ++actions[i] == m->n_strategies ; i++) {
+	actions[i] = 0;
+      }
+    }
+    free(actions);
   }
 }
 
@@ -66,72 +344,294 @@ void gatha_payoff_matrix_costs(GathaGame *g, int* actions, cost_t* costs,
 {
   int i, n;
   GathaPayoffMatrix *m;
+  payoff_t max;
+  payoff_t *p;
 
   m = (GathaPayoffMatrix*) g->data;
 
   n = m->n_players;
-  assert(n == 2);
-  for(i=0 ; i<n ; i++) {
-    costs[i] = m->max_payoff - gatha_payoff_matrix_get(m, i, actions[0], actions[1]);
+  max = gatha_payoff_matrix_max_payoff(m);
+  if (m->layout == GATHA_PAYOFF_LAYOUT_INTERLEAVED
+      && m->precision == GATHA_PAYOFF_DOUBLE) {
+    p = m->payoffs + payoff_matrix_index(m, 0, actions);
+    for(i=0 ; i<n ; i++) {
+      costs[i] = max - p[i];
+    }
+  } else {
+    for(i=0 ; i<n ; i++) {
+      costs[i] = max - payoff_matrix_read(m, payoff_matrix_index(m, i, actions));
+    }
   }
 }
 
 void gatha_payoff_matrix_payoffs(GathaGame *g, int* actions, payoff_t* payoffs,
 				 int thread_id)
 {
-  int i, n;
-  GathaPayoffMatrix *m;
+  gatha_payoff_matrix_payoffs_v((GathaPayoffMatrix*) g->data, actions, payoffs);
+}
 
-  m = (GathaPayoffMatrix*) g->data;
+void gatha_payoff_matrix_build_player_payoffs(GathaPayoffMatrix *m)
+{
+  int i, k, p, s;
+  long n, c, src;
+  int *actions;
+  payoff_t **pp;
+
+  // with the per-player layout, the tensors are the matrix itself
+  if (m->layout == GATHA_PAYOFF_LAYOUT_PER_PLAYER) return;
+  // a double copy of a reduced precision matrix would defeat its purpose
+  if (m->precision != GATHA_PAYOFF_DOUBLE) return;
+
+  p = m->n_players;
+  s = m->n_strategies;
+  n = m->size / p;
+
+  pp = m->player_payoffs;
+  if (pp == NULL) {
+    pp = (payoff_t**) malloc(p * sizeof(payoff_t*));
+    assert(pp != NULL);
+    for(i=0 ; i<p ; i++) {
+      pp[i] = (payoff_t*) malloc(n * sizeof(payoff_t));
+      assert(pp[i] != NULL);
+    }
+  }
+
+  actions = (int*) calloc(p, sizeof(int));
+  assert(actions != NULL);
+  for(c=0 ; c<n ; c++) {
+    src = c * p;
+    for(i=0 ; i<p ; i++) {
+      pp[i][payoff_matrix_player_index(m, i, actions)] = m->payoffs[src + i];
+    }
+    for(k=0 ; k<p && ++actions[k] == s ; k++) {
+      actions[k] = 0;
+    }
+  }
+  free(actions);
+
+  // the tensors are filled before the pointer is published
+  #pragma omp atomic write seq_cst
+  m->player_payoffs = pp;
+}
+
+/* returns the per-player copy, building it the first time it is needed;
+   several threads may need it at the same time. MCB and SFP build it before
+   starting their threads (see gatha_game_expected_payoffs_prepare). */
+static inline payoff_t** payoff_matrix_need_player_payoffs(GathaPayoffMatrix *m)
+{
+  payoff_t **pp;
+
+  #pragma omp atomic read seq_cst
+  pp = m->player_payoffs;
+  if (pp == NULL) {
+    #pragma omp critical (gatha_payoff_matrix_player_payoffs)
+    {
+      if (m->player_payoffs == NULL) gatha_payoff_matrix_build_player_payoffs(m);
+      pp = m->player_payoffs;
+    }
+  }
+  return pp;
+}
+
+/* same as gatha_simd_weighted_rows_add, for the payoffs of a reduced
+   precision matrix: row r starts at element base + r*stride, and its elements
+   are `step' apart */
+static void payoff_matrix_rows_add_reduced(GathaPayoffMatrix *m, long base,
+					   long stride, long step,
+					   const proba_t *w, payoff_t scale,
+					   payoff_t *out)
+{
+  int a, r, s;
+  payoff_t x;
+  const float *f;
+  const int16_t *q;
+
+  s = m->n_strategies;
+  for(r=0 ; r<s ; r++) {
+    if (w[r] == 0.0) continue;
+    x = scale * w[r];
+    if (m->precision == GATHA_PAYOFF_FLOAT) {
+      f = m->payoffs_float + base + r * stride;
+      for(a=0 ; a<s ; a++) {
+	out[a] += x * f[a * step];
+      }
+    } else {
+      q = m->payoffs_int16 + base + r * stride;
+      for(a=0 ; a<s ; a++) {
+	out[a] += x * (m->offset + m->scale * q[a * step]);
+      }
+    }
+  }
+}
+
+/* adds the payoffs of `player' to `out', weighted by the probability of the
+   strategy choices of players k and below. `base' is the index of the part of
+   the payoffs selected by the choices made so far, in `t' if it is not NULL
+   and in the reduced precision array otherwise, `strides' the strides of the
+   player in that array, and `w' the probability of the choices. The last
+   opponent is handled by the vectorized kernel when the player's own
+   strategy changes first. */
+static void payoff_matrix_contract(GathaPayoffMatrix *m, int player,
+				   proba_t **proba, const payoff_t *t,
+				   const long *strides, long base, int k,
+				   payoff_t w, payoff_t *out)
+{
+  int a, s, inner;
+
+  s = m->n_strategies;
+  inner = (player == 0) ? 1 : 0;
+  if (k == player) k--;
+
+  if (k == inner) {
+    if (t != NULL) {
+      gatha_simd_weighted_rows_add(t + base, strides[k], proba[k], w, s, s, out);
+    } else {
+      payoff_matrix_rows_add_reduced(m, base, strides[k], strides[player],
+				     proba[k], w, out);
+    }
+    return;
+  }
+
+  for(a=0 ; a<s ; a++) {
+    if (proba[k][a] == 0.0) continue;
+    payoff_matrix_contract(m, player, proba, t, strides, base + a * strides[k],
+			   k-1, w * proba[k][a], out);
+  }
+}
+
+void gatha_payoff_matrix_2p_best_responses(GathaPayoffMatrix *m, proba_t **proba,
+					   payoff_t **payoffs, int *best)
+{
+  int i, s;
+  payoff_t *tmp = NULL;
+  payoff_t *out;
+
+  assert(m->n_players == 2);
+  s = m->n_strategies;
+
+  for(i=0 ; i<2 ; i++) {
+    out = (payoffs != NULL) ? payoffs[i] : NULL;
+    if (out == NULL) {
+      if (best == NULL) continue;
+      if (tmp == NULL) {
+	tmp = (payoff_t*) malloc(s * sizeof(payoff_t));
+	assert(tmp != NULL);
+      }
+      out = tmp;
+    }
+    gatha_payoff_matrix_expected_payoffs(m, i, proba, out);
+    if (best != NULL) best[i] = gatha_simd_argmax(out, s);
+  }
+  free(tmp);
+}
+
+void gatha_payoff_matrix_expected_payoffs(GathaPayoffMatrix *m, int player,
+					  proba_t **proba, payoff_t *payoffs)
+{
+  int a, n;
+
+  assert(player >= 0 && player < m->n_players);
 
   n = m->n_players;
-  assert(n == 2);
-  for(i=0 ; i<n ; i++) {
-    payoffs[i] = gatha_payoff_matrix_get(m, i, actions[0], actions[1]);
+  for(a=0 ; a<m->n_strategies ; a++) {
+    payoffs[a] = 0.0;
+  }
+  if (m->precision == GATHA_PAYOFF_DOUBLE) {
+    payoff_matrix_contract(m, player, proba,
+			   payoff_matrix_need_player_payoffs(m)[player],
+			   m->player_strides + player * n, 0, n - 1, 1.0, payoffs);
+  } else {
+    payoff_matrix_contract(m, player, proba, NULL, m->strides + player * n,
+			   m->offsets[player], n - 1, 1.0, payoffs);
   }
 }
 
 void gatha_payoff_matrix_set(GathaPayoffMatrix *m, int player, payoff_t value, ...)
 {
   va_list arg;
-  int i, v, n, s;
-  // payoff matrix index
-  int p;
+  int i, n;
+  int *actions;
 
   n = m->n_players;
-  s = m->n_strategies;
-  p = player;
+  actions = (int*) malloc(n * sizeof(int));
+  assert(actions != NULL);
   va_start(arg, value);
   for(i=0 ; i<n ; i++) {
-    v = va_arg(arg, int);
-    p += v * pow(s, i) * n;
+    actions[i] = va_arg(arg, int);
   }
+  va_end(arg);
 
-  m->payoffs[p] = value;
+  payoff_matrix_store(m, player, actions, value);
+  free(actions);
+}
 
-  gatha_payoff_matrix_compute_max_payoff(m);
+void gatha_payoff_matrix_set_v(GathaPayoffMatrix *m, int player,
+			       const int *actions, payoff_t value)
+{
+  payoff_matrix_store(m, player, actions, value);
+}
 
-  va_end(arg);
+void gatha_payoff_matrix_load(GathaPayoffMatrix *m, const payoff_t *payoffs)
+{
+  long i;
+
+  assert(payoffs != NULL);
+  if (m->precision == GATHA_PAYOFF_DOUBLE) {
+    memcpy(m->payoffs, payoffs, m->size * sizeof(payoff_t));
+  } else {
+    for(i=0 ; i<m->size ; i++) {
+      payoff_matrix_write(m, i, payoffs[i]);
+    }
+  }
+  gatha_payoff_matrix_compute_max_payoff(m);
+  if (m->layout == GATHA_PAYOFF_LAYOUT_INTERLEAVED && m->player_payoffs != NULL)
+    gatha_payoff_matrix_build_player_payoffs(m);
 }
 
 payoff_t gatha_payoff_matrix_get(GathaPayoffMatrix *m, int player,  ...)
 {
   va_list arg;
-  int i, v, n, s;
+  int i, v, n;
+  const long *strides;
   // payoff matrix index
-  int p;
+  long p;
 
   n = m->n_players;
-  s = m->n_strategies;
-  p = player;
+  strides = m->strides + player * n;
+  p = m->offsets[player];
   va_start(arg, player);
   for(i=0 ; i<n ; i++) {
     v = va_arg(arg, int);
-    p += v * pow(s, i) * n;
+    p += v * strides[i];
   }
 
   va_end(arg);
-  return m->payoffs[p];
+  return payoff_matrix_read(m, p);
+}
+
+payoff_t gatha_payoff_matrix_get_v(GathaPayoffMatrix *m, int player,
+				   const int *actions)
+{
+  return payoff_matrix_read(m, payoff_matrix_index(m, player, actions));
+}
+
+void gatha_payoff_matrix_payoffs_v(GathaPayoffMatrix *m, const int *actions,
+				   payoff_t *payoffs)
+{
+  int i;
+  payoff_t *p;
+
+  if (m->layout == GATHA_PAYOFF_LAYOUT_INTERLEAVED
+      && m->precision == GATHA_PAYOFF_DOUBLE) {
+    p = m->payoffs + payoff_matrix_index(m, 0, actions);
+    for(i=0 ; i<m->n_players ; i++) {
+      payoffs[i] = p[i];
+    }
+  } else {
+    for(i=0 ; i<m->n_players ; i++) {
+      payoffs[i] = payoff_matrix_read(m, payoff_matrix_index(m, i, actions));
+    }
+  }
 }
 
 GathaPayoffMatrix* gatha_payoff_matrix_2p_from_file(FILE *f)
@@ -140,11 +640,15 @@ GathaPayoffMatrix* gatha_payoff_matrix_2p_from_file(FILE *f)
   int p, s;
   // loop indices
   int i, j, k;
+  // strategy choices of the current cell
+  int actions[2];
   // counter
   int c;
   int value;
   GathaPayoffMatrix *m = NULL;
-  char buffer[1024];
+  // rows can be long for large games, so getline allocates the buffer
+  char *buffer = NULL;
+  size_t buffer_size = 0;
   char *ptr, *token;
   char *ptr2, *token2;
 
@@ -163,19 +667,21 @@ GathaPayoffMatrix* gatha_payoff_matrix_2p_from_file(FILE *f)
   // read the matrix, 2 dimensions, S rows, S columns,
   // P values in each cell
   for(i=0 ; i<s ; i++) {
-    ptr = fgets(buffer, 1024, f);
-    if (ptr == NULL) goto error;
+    if (getline(&buffer, &buffer_size, f) == -1) goto error;
     j = 0;
     // for each column
     token = strtok_r(buffer, ";", &ptr);
     while(token != NULL) {
+      if (j >= s) goto error;
       // for each value in a cell
       k = 0;
       token2 = strtok_r(token, ",", &ptr2);
       while(token2 != NULL) {
 	c = sscanf(token2, "%d", &value);
-	if (c != 1) goto error;
-	gatha_payoff_matrix_set(m, k, (payoff_t)value, i, j);
+	if (c != 1 || k >= p) goto error;
+	actions[0] = i;
+	actions[1] = j;
+	gatha_payoff_matrix_set_v(m, k, actions, (payoff_t)value);
 	token2 = strtok_r(NULL, ",", &ptr2);
 	k++;
       }
@@ -191,7 +697,9 @@ GathaPayoffMatrix* gatha_payoff_matrix_2p_from_file(FILE *f)
  error:
   fprintf(stderr, "Could not load file\n"); 
   if (m != NULL) gatha_payoff_matrix_free(m);
+  free(buffer);
   return NULL;
  ok:
+  free(buffer);
   return m;
 }
@@ -4,6 +4,35 @@
 #include "types.h"
 
 #include <stdarg.h>
+#include <stdint.h>
+
+/** Memory layouts of the payoffs of a GathaPayoffMatrix. */
+typedef enum {
+  /** The payoffs of all the players for a choice of strategies are stored
+   * next to each other. Reading the payoffs of a choice of strategies is
+   * cheap, but reading the payoffs of one player strides through memory. */
+  GATHA_PAYOFF_LAYOUT_INTERLEAVED = 0,
+
+  /** One contiguous tensor per player, the player's own strategy changing
+   * first. Best responses and expected payoffs read memory sequentially. */
+  GATHA_PAYOFF_LAYOUT_PER_PLAYER
+} GathaPayoffLayout;
+
+/** Storage precisions of the payoffs of a GathaPayoffMatrix. The accessors
+ * always return payoff_t values, reduced precisions are widened on read. */
+typedef enum {
+  /** payoff_t values, ie. doubles. */
+  GATHA_PAYOFF_DOUBLE = 0,
+
+  /** Single precision floats: half the memory of GATHA_PAYOFF_DOUBLE. */
+  GATHA_PAYOFF_FLOAT,
+
+  /** 16-bit integers, with a scale and an offset common to the whole matrix:
+   * a quarter of the memory of GATHA_PAYOFF_DOUBLE. The range of the payoffs
+   * must be known when the matrix is created, and the values are rounded to
+   * one of 65535 levels. */
+  GATHA_PAYOFF_INT16
+} GathaPayoffPrecision;
 
 /** Normal Form game. The payoffs for all possible choices of strategies are
  *  stored in a matrix of dimension n_players, that contains n_strategies^(n_players+1)
@@ -17,16 +46,75 @@ struct _gatha_payoff_matrix {
    same number of strategies. */
   int n_strategies;
 
-  /** Payoffs for all possible choices of strategies. The array should not
-   * be accessed directly, but through accessors like gatha_payoff_matrix_get and _set.
+  /** Memory layout of the `payoffs' array. */
+  GathaPayoffLayout layout;
+
+  /** Storage precision. Only the array matching it is allocated among
+   * `payoffs', `payoffs_float' and `payoffs_int16'. */
+  GathaPayoffPrecision precision;
+
+  /** Payoffs for all possible choices of strategies, or NULL if they are
+   * stored with a reduced precision. The array should not be accessed
+   * directly, but through accessors like gatha_payoff_matrix_get and _set.
    * \see gatha_payoff_matrix_get
    * \see gatha_payoff_matrix_set
    */
   payoff_t *payoffs;
 
+  /** Payoffs stored as floats, with GATHA_PAYOFF_FLOAT, or NULL. */
+  float *payoffs_float;
+
+  /** Payoffs stored as 16-bit integers, with GATHA_PAYOFF_INT16, or NULL.
+   * The payoff is offset + scale * payoffs_int16[i]. */
+  int16_t *payoffs_int16;
+
+  /** Quantization parameters of GATHA_PAYOFF_INT16. */
+  payoff_t scale, offset;
+
+  /** Number of payoffs outside of the range of GATHA_PAYOFF_INT16 that were
+   * clamped to it. A warning is printed for the first one. */
+  long n_clamped;
+
+  /** Number of elements in the payoffs array, ie. n_strategies^n_players * n_players. */
+  long size;
+
+  /** Index of the payoff of each player when all the players choose their
+   * first strategy. */
+  long *offsets;
+
+  /** Index strides. strides[i*n_players + k] is the distance, in the `payoffs'
+   * array, between the payoffs of player i for two consecutive strategies of
+   * player k. They are computed once by gatha_payoff_matrix_new, so that the
+   * accessors only need integer arithmetic. */
+  long *strides;
+
+  /** Index strides in the tensors of `player_payoffs', in the same format as
+   * `strides'. */
+  long *player_strides;
+
+  /** Per-player tensors, or NULL. player_payoffs[i] contains the
+   * n_strategies^n_players payoffs of player i, its own strategy changing
+   * first: expected payoffs and best responses then read contiguous memory,
+   * and can be vectorized. With GATHA_PAYOFF_LAYOUT_PER_PLAYER, they point into
+   * `payoffs'. Otherwise they are a copy, built by
+   * gatha_payoff_matrix_build_player_payoffs, by MCB and SFP before their
+   * threads compute exact expected payoffs, or the first time they are
+   * needed, and kept up to date by the setters. They are never
+   * built with a reduced precision, which would defeat its purpose. */
+  payoff_t **player_payoffs;
+
   /** Maximum payoff in the matrix. It is used, for example, for turning
-   * a gain into a cost when needed: the cost is then max_payoff-actual_payoff. */
+   * a gain into a cost when needed: the cost is then max_payoff-actual_payoff.
+   * It is maintained by gatha_payoff_matrix_set, and should be read through
+   * gatha_payoff_matrix_max_payoff.
+   * \see max_payoff_count */
   payoff_t max_payoff;
+
+  /** Number of payoffs equal to `max_payoff'. When the last of them is
+   * overwritten with a smaller value, the maximum is computed again right
+   * away: it is always up to date, and the threads computing costs read it
+   * without a lock. */
+  long max_payoff_count;
 } ;
 
 /** Creates a GathaPayoffMatrix. The `payoffs' array contains ns^(np+1) elements and
@@ -36,16 +124,47 @@ struct _gatha_payoff_matrix {
  */
 extern GathaPayoffMatrix* gatha_payoff_matrix_new(int np, int ns);
 
+/** Creates a GathaPayoffMatrix with a given memory layout.
+ * gatha_payoff_matrix_new uses GATHA_PAYOFF_LAYOUT_INTERLEAVED.
+ * @param np Number of players.
+ * @param ns Number of strategies for each player.
+ * @param layout Memory layout of the payoffs.
+ */
+extern GathaPayoffMatrix* gatha_payoff_matrix_new_with_layout(int np, int ns,
+							      GathaPayoffLayout layout);
+
+/** Creates a GathaPayoffMatrix with a given memory layout and storage
+ * precision, for games too large to be stored as doubles.
+ * @param np Number of players.
+ * @param ns Number of strategies for each player.
+ * @param layout Memory layout of the payoffs.
+ * @param precision Storage precision of the payoffs.
+ * @param min Smallest payoff of the game, only used by GATHA_PAYOFF_INT16.
+ * @param max Largest payoff of the game, only used by GATHA_PAYOFF_INT16.
+ * A payoff set outside of [min, max] is clamped to it, with a warning.
+ * \see n_clamped
+ */
+extern GathaPayoffMatrix* gatha_payoff_matrix_new_with_precision(int np, int ns,
+								 GathaPayoffLayout layout,
+								 GathaPayoffPrecision precision,
+								 payoff_t min, payoff_t max);
+
 /** Frees a GathaPayoffMatrix. The `payoffs' array is freed first. */
 extern void gatha_payoff_matrix_free(GathaPayoffMatrix *m);
 
+/** Computes the maximum payoff of the matrix by scanning all its elements,
+ * and counts the elements equal to it. */
+extern void gatha_payoff_matrix_compute_max_payoff(GathaPayoffMatrix *m);
+
+/** Returns the maximum payoff of the matrix. It is kept up to date by the
+ * setters, so several threads can call this while no payoff is set. */
+extern payoff_t gatha_payoff_matrix_max_payoff(GathaPayoffMatrix *m);
+
 /** Prints the matrix in a file descriptor. */
 extern void gatha_payoff_matrix_fprintf(GathaPayoffMatrix *m, FILE *f);
 
-/** Retrieves the players' costs for a choice of strategies.
- * 
- * \todo So far, it only works with two-player games. Make it work for
- * any number of players.
+/** Retrieves the players' costs for a choice of strategies. The cost of a
+ * player is the maximum payoff of the matrix minus its payoff.
  *
  * @param g The game
  * @param actions The integer array containing the strategy choices for the players.
@@ -54,10 +173,9 @@ extern void gatha_payoff_matrix_fprintf(GathaPayoffMatrix *m, FILE *f);
 extern void gatha_payoff_matrix_costs(GathaGame *g, int* actions,
 				      cost_t* costs, int trhead_id);
 
-/** Retrieves the players' payoffs for a choice of strategies.
- * 
- * \todo So far, it only works with two-player games. Make it work for
- * any number of players.
+/** Retrieves the players' payoffs for a choice of strategies. This is the
+ * payoff callback used by gatha_game_from_matrix; it works with any number
+ * of players.
  *
  * @param g The game
  * @param actions The integer array containing the strategy choices for the players.
@@ -66,6 +184,40 @@ extern void gatha_payoff_matrix_costs(GathaGame *g, int* actions,
 extern void gatha_payoff_matrix_payoffs(GathaGame *g, int* actions,
 					payoff_t* payoffs, int thread_id);
 
+/** Computes the exact expected payoff of each strategy of a player, when the
+ * other players choose their strategies according to their probability vectors.
+ * The expectation is a contraction of the payoff tensor with the other players'
+ * probability vectors: a matrix-vector product for two-player games. Strategies
+ * with zero probability are skipped, so concentrated vectors are cheap.
+ * @param m The game matrix
+ * @param player The player
+ * @param proba The probability vectors of all the players. proba[player] is not used.
+ * @param[out] payoffs The payoff_t array where the n_strategies expected payoffs
+ * will be stored.
+ */
+extern void gatha_payoff_matrix_expected_payoffs(GathaPayoffMatrix *m, int player,
+						 proba_t **proba, payoff_t *payoffs);
+
+/** Builds the per-player copy of the payoffs. It does nothing with
+ * GATHA_PAYOFF_LAYOUT_PER_PLAYER or a reduced precision.
+ * \see player_payoffs */
+extern void gatha_payoff_matrix_build_player_payoffs(GathaPayoffMatrix *m);
+
+/** Computes the expected payoffs and best responses of both players of a
+ * two-player game: A.q for the first player and B^T.p for the second one,
+ * where A and B are the players' payoffs and p and q their probability vectors.
+ * The products use the vectorized kernels of simd.h.
+ * @param m The game matrix
+ * @param proba The probability vectors of the two players
+ * @param[out] payoffs payoffs[i] receives the n_strategies expected payoffs of
+ * player i. Either of them may be NULL.
+ * @param[out] best best[i] receives the best response of player i. May be NULL.
+ */
+extern void gatha_payoff_matrix_2p_best_responses(GathaPayoffMatrix *m,
+						  proba_t **proba,
+						  payoff_t **payoffs,
+						  int *best);
+
 /** Sets the payoff of a player, given a set of strategy choices.
  * \see gatha_payoff_matrix_get explains how the variable length list of
  * strategies is used.
@@ -78,6 +230,25 @@ extern void gatha_payoff_matrix_payoffs(GathaGame *g, int* actions,
 extern void gatha_payoff_matrix_set(GathaPayoffMatrix *m, int player,
 				    payoff_t value, ...);
 
+/** Sets the payoff of a player, given an array of strategy choices.
+ * This is the non-variadic version of gatha_payoff_matrix_set.
+ * @param m The game matrix
+ * @param player The player
+ * @param actions The integer array containing the strategy choices for the players.
+ * @param value The new payoff value
+ */
+extern void gatha_payoff_matrix_set_v(GathaPayoffMatrix *m, int player,
+				      const int *actions, payoff_t value);
+
+/** Sets all the payoffs of the matrix at once, and computes the maximum payoff
+ * only once. This is much faster than calling gatha_payoff_matrix_set for every
+ * element. The payoffs are converted to the storage precision of the matrix.
+ * @param m The game matrix
+ * @param payoffs An array of `m->size' elements, using the same layout as
+ * `m->payoffs'.
+ */
+extern void gatha_payoff_matrix_load(GathaPayoffMatrix *m, const payoff_t *payoffs);
+
 /** Retrieves the payoff of a player, given a set of strategy choices.
  * \remark For a two-player game with 5 strategies, the payoff for player 1,
  * when 1 plays 3 and 2 plays 4 is given by: \c gatha_payoff_matrix(m, 1, 3, 4);
@@ -91,6 +262,25 @@ extern void gatha_payoff_matrix_set(GathaPayoffMatrix *m, int player,
  */
 extern payoff_t gatha_payoff_matrix_get(GathaPayoffMatrix *m, int player,  ...);
 
+/** Retrieves the payoff of a player, given an array of strategy choices.
+ * This is the non-variadic version of gatha_payoff_matrix_get.
+ * @param m The game matrix
+ * @param player The player
+ * @param actions The integer array containing the strategy choices for the players.
+ */
+extern payoff_t gatha_payoff_matrix_get_v(GathaPayoffMatrix *m, int player,
+					  const int *actions);
+
+/** Retrieves the payoffs of all the players, given an array of strategy choices.
+ * The payoffs of a choice of strategies are stored next to each other, so this
+ * only computes the index once.
+ * @param m The game matrix
+ * @param actions The integer array containing the strategy choices for the players.
+ * @param[out] payoffs The payoff_t array where the n_players payoffs will be stored.
+ */
+extern void gatha_payoff_matrix_payoffs_v(GathaPayoffMatrix *m, const int *actions,
+					  payoff_t *payoffs);
+
 /** Reads a two-player game from a text file.
  * File format:
  *
@@ -0,0 +1,345 @@
+#include "payoff_store.h"
+#include "game.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define STORE_MAGIC "GATHAPS1"
+#define STORE_VERSION 1
+#define STORE_HEADER_SIZE 16
+#define STORE_MIN_MAP_SIZE (1 << 20)
+
+/* fixed part of a record, followed by the strategies and the payoffs */
+typedef struct {
+  uint64_t game_id;
+  uint32_t n_players;
+  uint32_t size;
+} PayoffStoreRecord;
+
+/* offset of the payoffs in a record of n players */
+static inline size_t payoff_store_payoffs_offset(int n)
+{
+  return sizeof(PayoffStoreRecord) + ((n * sizeof(int) + 7) & ~((size_t) 7));
+}
+
+static inline uint64_t payoff_store_hash(uint64_t game_id, const int *actions,
+					 int n)
+{
+  int i;
+  uint64_t h;
+
+  // FNV-1a over the game identifier and the strategies
+  h = 14695981039346656037ULL ^ game_id;
+  for(i=0 ; i<n ; i++) {
+    h = (h ^ (uint32_t) actions[i]) * 1099511628211ULL;
+  }
+  return h ^ (h >> 29);
+}
+
+/* record of the game for a choice of strategies, or NULL */
+static const PayoffStoreRecord* payoff_store_lookup(GathaPayoffStore *s,
+						    const int *actions)
+{
+  int n;
+  long h;
+  const PayoffStoreRecord *r;
+
+  n = s->game->n_players;
+  h = payoff_store_hash(s->game_id, actions, n) & (s->n_slots - 1);
+  while (s->slots[h] != 0) {
+    r = (const PayoffStoreRecord*) (s->map + s->slots[h] - 1);
+    if (memcmp(r + 1, actions, n * sizeof(int)) == 0) return r;
+    h = (h + 1) & (s->n_slots - 1);
+  }
+  return NULL;
+}
+
+/* adds a record to the hash table, which stays at most half full */
+static void payoff_store_index(GathaPayoffStore *s, size_t offset)
+{
+  long i, h, *old, n_old;
+  const PayoffStoreRecord *r;
+
+  if (2 * (s->n_records + 1) > s->n_slots) {
+    old = s->slots;
+    n_old = s->n_slots;
+    s->n_slots *= 2;
+    s->slots = (long*) calloc(s->n_slots, sizeof(long));
+    assert(s->slots != NULL);
+    s->n_records = 0;
+    for(i=0 ; i<n_old ; i++) {
+      if (old[i] != 0) payoff_store_index(s, old[i] - 1);
+    }
+    free(old);
+  }
+
+  r = (const PayoffStoreRecord*) (s->map + offset);
+  h = payoff_store_hash(s->game_id, (const int*) (r + 1), r->n_players)
+    & (s->n_slots - 1);
+  while (s->slots[h] != 0) h = (h + 1) & (s->n_slots - 1);
+  s->slots[h] = offset + 1;
+  s->n_records++;
+}
+
+/* walks the complete records between `from' and `to', indexing the ones of
+   the game if `index' is TRUE, and returns the end of the last one */
+static size_t payoff_store_scan(GathaPayoffStore *s, size_t from, size_t to,
+				boolean index)
+{
+  const PayoffStoreRecord *r;
+
+  while (from + sizeof(PayoffStoreRecord) <= to) {
+    r = (const PayoffStoreRecord*) (s->map + from);
+    if (r->size < sizeof(PayoffStoreRecord) || from + r->size > to) break;
+    if (index && r->game_id == s->game_id
+	&& r->n_players == (uint32_t) s->game->n_players
+	&& payoff_store_lookup(s, (const int*) (r + 1)) == NULL) {
+      payoff_store_index(s, from);
+    }
+    from += r->size;
+  }
+  return from;
+}
+
+/* maps the first `size' bytes of the file, at least. The mapping goes past
+   the end of the file, and doubles when the file outgrows it, so that the
+   pages already read stay mapped while records are appended; only the
+   bytes within the file are ever read. */
+static void payoff_store_map(GathaPayoffStore *s, size_t size)
+{
+  size_t new_size;
+
+  if (size <= s->map_size) return;
+  new_size = (s->map_size > 0) ? s->map_size : STORE_MIN_MAP_SIZE;
+  while (new_size < size) new_size *= 2;
+
+  if (s->map != NULL) munmap(s->map, s->map_size);
+  s->map = (char*) mmap(NULL, new_size, PROT_READ, MAP_SHARED, s->fd, 0);
+  assert(s->map != MAP_FAILED);
+  s->map_size = new_size;
+}
+
+/* indexes the records appended since the last call, by any process */
+static void payoff_store_refresh(GathaPayoffStore *s)
+{
+  struct stat st;
+
+  if (fstat(s->fd, &st) != 0 || (size_t) st.st_size <= s->indexed) return;
+
+  // writers hold an exclusive lock, so there is no partial record
+  flock(s->fd, LOCK_SH);
+  fstat(s->fd, &st);
+  payoff_store_map(s, st.st_size);
+  s->indexed = payoff_store_scan(s, s->indexed, st.st_size, TRUE);
+  flock(s->fd, LOCK_UN);
+}
+
+static void payoff_store_append(GathaPayoffStore *s, const int *actions,
+				const payoff_t *payoffs)
+{
+  int n;
+  size_t offset, size;
+  ssize_t written;
+  char *buffer;
+  PayoffStoreRecord *r;
+  struct stat st;
+
+  n = s->game->n_players;
+  offset = payoff_store_payoffs_offset(n);
+  size = offset + n * sizeof(payoff_t);
+  buffer = (char*) calloc(1, size);
+  assert(buffer != NULL);
+
+  r = (PayoffStoreRecord*) buffer;
+  r->game_id = s->game_id;
+  r->n_players = n;
+  r->size = size;
+  memcpy(r + 1, actions, n * sizeof(int));
+  memcpy(buffer + offset, payoffs, n * sizeof(payoff_t));
+
+  // the file is opened with O_APPEND, and a single write keeps the record
+  // in one piece; a failed write is undone before releasing the lock, since
+  // the other processes stop indexing at an incomplete record
+  flock(s->fd, LOCK_EX);
+  if (fstat(s->fd, &st) == 0) {
+    written = write(s->fd, buffer, size);
+    if (written != (ssize_t) size) {
+      perror("payoff store");
+      if (written > 0 && ftruncate(s->fd, st.st_size) != 0)
+	perror("payoff store");
+    }
+  }
+  flock(s->fd, LOCK_UN);
+
+  free(buffer);
+}
+
+GathaPayoffStore* gatha_payoff_store_open(const char *filename, GathaGame *g,
+					  uint64_t game_id)
+{
+  GathaPayoffStore *s;
+  struct stat st;
+  char header[STORE_HEADER_SIZE];
+  uint64_t version;
+  size_t end;
+
+  assert(filename != NULL && g != NULL && g->payoff_func != NULL);
+  assert(sizeof(int) == 4);
+
+  s = (GathaPayoffStore*) malloc(sizeof(GathaPayoffStore));
+  if (s == NULL) return NULL;
+
+  s->game = g;
+  s->game_id = game_id;
+  s->map = NULL;
+  s->map_size = 0;
+  s->indexed = STORE_HEADER_SIZE;
+  s->n_slots = 64;
+  s->slots = (long*) calloc(s->n_slots, sizeof(long));
+  s->n_records = 0;
+  s->hits = 0;
+  s->misses = 0;
+  assert(s->slots != NULL);
+  pthread_rwlock_init(&s->lock, NULL);
+
+  s->fd = open(filename, O_RDWR | O_CREAT | O_APPEND, 0644);
+  if (s->fd < 0) {
+    perror(filename);
+    pthread_rwlock_destroy(&s->lock);
+    free(s->slots);
+    free(s);
+    return NULL;
+  }
+
+  flock(s->fd, LOCK_EX);
+  fstat(s->fd, &st);
+  if (st.st_size == 0) {
+    // new store
+    memset(header, 0, STORE_HEADER_SIZE);
+    memcpy(header, STORE_MAGIC, 8);
+    version = STORE_VERSION;
+    memcpy(header + 8, &version, sizeof(uint64_t));
+    if (write(s->fd, header, STORE_HEADER_SIZE) != STORE_HEADER_SIZE)
+      goto error;
+  } else {
+    if (st.st_size < STORE_HEADER_SIZE
+	|| pread(s->fd, header, STORE_HEADER_SIZE, 0) != STORE_HEADER_SIZE)
+      goto error;
+    memcpy(&version, header + 8, sizeof(uint64_t));
+    if (memcmp(header, STORE_MAGIC, 8) != 0 || version != STORE_VERSION)
+      goto error;
+
+    // remove the record a crashed process may have left incomplete
+    payoff_store_map(s, st.st_size);
+    end = payoff_store_scan(s, STORE_HEADER_SIZE, st.st_size, FALSE);
+    if (end < (size_t) st.st_size && ftruncate(s->fd, end) != 0)
+      goto error;
+  }
+  flock(s->fd, LOCK_UN);
+
+  payoff_store_refresh(s);
+  return s;
+
+ error:
+  fprintf(stderr, "%s: not a payoff store\n", filename);
+  flock(s->fd, LOCK_UN);
+  gatha_payoff_store_close(s);
+  return NULL;
+}
+
+void gatha_payoff_store_close(GathaPayoffStore *s)
+{
+  assert(s != NULL);
+  if (s->map != NULL) munmap(s->map, s->map_size);
+  close(s->fd);
+  pthread_rwlock_destroy(&s->lock);
+  free(s->slots);
+  free(s);
+}
+
+static void payoff_store_expected_payoffs(GathaGame *g, int player,
+					  proba_t **proba, payoff_t *payoffs,
+					  int thread_id)
+{
+  GathaPayoffStore *s;
+
+  s = (GathaPayoffStore*) g->data;
+  s->game->expected_payoffs_func(s->game, player, proba, payoffs, thread_id);
+}
+
+static void payoff_store_expected_payoffs_prepare(GathaGame *g, proba_t **proba)
+{
+  GathaPayoffStore *s;
+
+  s = (GathaPayoffStore*) g->data;
+  gatha_game_expected_payoffs_prepare(s->game, proba);
+}
+
+GathaGame* gatha_game_from_payoff_store(GathaPayoffStore *s)
+{
+  GathaGame *g;
+  assert(s != NULL);
+  g = gatha_game_new(s->game->n_players, s->game->n_strategies);
+  g->payoff_func = gatha_payoff_store_payoffs;
+  if (s->game->expected_payoffs_func != NULL)
+    g->expected_payoffs_func = payoff_store_expected_payoffs;
+  g->expected_payoffs_prepare_func = payoff_store_expected_payoffs_prepare;
+  g->data = s;
+  return g;
+}
+
+/* copies the payoffs of a record, if there is one; the caller holds the lock */
+static inline boolean payoff_store_read(GathaPayoffStore *s, const int *actions,
+					payoff_t *payoffs)
+{
+  const PayoffStoreRecord *r;
+  int n;
+
+  n = s->game->n_players;
+  r = payoff_store_lookup(s, actions);
+  if (r == NULL) return FALSE;
+  memcpy(payoffs, (const char*) r + payoff_store_payoffs_offset(n),
+	 n * sizeof(payoff_t));
+  return TRUE;
+}
+
+void gatha_payoff_store_payoffs(GathaGame *g, int *actions,
+				payoff_t *payoffs, int thread_id)
+{
+  GathaPayoffStore *s;
+  boolean found;
+
+  s = (GathaPayoffStore*) g->data;
+
+  // hits only read the mapping and the index, so the threads share the lock
+  pthread_rwlock_rdlock(&s->lock);
+  found = payoff_store_read(s, actions, payoffs);
+  pthread_rwlock_unlock(&s->lock);
+
+  if (!found) {
+    // another process may have computed it; the mapping may move
+    pthread_rwlock_wrlock(&s->lock);
+    payoff_store_refresh(s);
+    found = payoff_store_read(s, actions, payoffs);
+    pthread_rwlock_unlock(&s->lock);
+  }
+
+  if (found) {
+    #pragma omp atomic
+    s->hits++;
+    return;
+  }
+  #pragma omp atomic
+  s->misses++;
+
+  s->game->payoff_func(s->game, actions, payoffs, thread_id);
+
+  pthread_rwlock_wrlock(&s->lock);
+  payoff_store_append(s, actions, payoffs);
+  payoff_store_refresh(s);
+  pthread_rwlock_unlock(&s->lock);
+}
@@ -0,0 +1,97 @@
+#ifndef _GATHA_PAYOFF_STORE_H_
+#define _GATHA_PAYOFF_STORE_H_
+
+#include "types.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/** Persistent payoff cache. The payoffs computed by a game are appended to a
+ *  file, and read back by later runs instead of calling the payoff function
+ *  again. Several processes can use the same file at the same time: records
+ *  are appended under an exclusive flock(2), and read through mmap(2) under a
+ *  shared one. A file can hold the payoffs of several games, told apart by a
+ *  game identifier chosen by the user, for example a hash of the parameters
+ *  of a simulation.
+ *
+ *  The file starts with an 8-byte magic string and a 64-bit version, followed
+ *  by records, all in native byte order:
+ *  - the game identifier (64 bits),
+ *  - the number of players n (32 bits) and the size of the record in bytes
+ *    (32 bits),
+ *  - the n strategies (32 bits each), padded to a multiple of 8 bytes,
+ *  - the n payoffs (payoff_t each).
+ *
+ *  Within a process, threads look payoffs up under a shared lock, so that
+ *  hits run in parallel; the mapping and the index only change under the
+ *  exclusive lock, taken on a miss.
+ */
+struct _gatha_payoff_store {
+  /** The game whose payoffs are stored. */
+  GathaGame *game;
+
+  /** Identifier of the game in the file. */
+  uint64_t game_id;
+
+  /** File descriptor of the store. */
+  int fd;
+
+  /** Read-only mapping of the file, or NULL. */
+  char *map;
+
+  /** Size of the mapping, in bytes. It may go past the end of the file. */
+  size_t map_size;
+
+  /** Size of the part of the file already indexed, in bytes. */
+  size_t indexed;
+
+  /** Hash table of the records of the game: offset+1 of a record in the
+   * file, or 0 for an empty slot. */
+  long *slots;
+
+  /** Number of slots, a power of two. */
+  long n_slots;
+
+  /** Number of records of the game in the file. */
+  long n_records;
+
+  /** Number of lookups that found a record. */
+  long hits;
+
+  /** Number of lookups that called the stored game. */
+  long misses;
+
+  /** Protects `map', `map_size', `indexed' and the hash table between the
+   * threads of the process. */
+  pthread_rwlock_t lock;
+} ;
+
+/** Opens a payoff store for a game, creating the file if needed. A record
+ * left incomplete by a crashed process is removed.
+ * @param filename The file holding the payoffs
+ * @param g The game whose payoffs are stored
+ * @param game_id Identifier of the game in the file
+ * @returns The store, or NULL if the file cannot be opened or is not a
+ * payoff store.
+ */
+extern GathaPayoffStore* gatha_payoff_store_open(const char *filename,
+						 GathaGame *g, uint64_t game_id);
+
+/** Closes a payoff store. The stored game is not freed. */
+extern void gatha_payoff_store_close(GathaPayoffStore *s);
+
+/** Creates a game using a payoff store for computing the payoffs. It can
+ * replace the stored game anywhere; it has the same expected payoffs hooks.
+ */
+extern GathaGame* gatha_game_from_payoff_store(GathaPayoffStore *s);
+
+/** Retrieves the players' payoffs for a choice of strategies from the store,
+ * calling the payoff function of the stored game and appending the result to
+ * the file if they are not found. This is the payoff callback used by
+ * gatha_game_from_payoff_store.
+ */
+extern void gatha_payoff_store_payoffs(GathaGame *g, int *actions,
+				       payoff_t *payoffs, int thread_id);
+
+#endif /* _GATHA_PAYOFF_STORE_H_ */
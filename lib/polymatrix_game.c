@@ -0,0 +1,169 @@
+#include "polymatrix_game.h"
+#include "game.h"
+#include "simd.h"
+
+#include <string.h>
+
+static int polymatrix_compare_int(const void *a, const void *b)
+{
+  return *(const int*) a - *(const int*) b;
+}
+
+GathaPolymatrixGame* gatha_polymatrix_game_new(int p, int s, long ne,
+					       const int *edges)
+{
+  GathaPolymatrixGame *pg;
+  long e, *next;
+  int i;
+
+  assert(p > 1 && s > 0 && ne >= 0);
+  assert(ne == 0 || edges != NULL);
+
+  pg = (GathaPolymatrixGame *) malloc(sizeof(GathaPolymatrixGame));
+  if (pg == NULL) return NULL;
+
+  pg->n_players = p;
+  pg->n_strategies = s;
+  pg->n_edges = ne;
+  pg->first_edge = (long*) calloc(p + 1, sizeof(long));
+  pg->neighbors = (int*) malloc((ne > 0 ? ne : 1) * sizeof(int));
+  pg->matrices = (payoff_t*) calloc((ne > 0 ? ne : 1) * s * s, sizeof(payoff_t));
+  next = (long*) malloc(p * sizeof(long));
+  assert(pg->first_edge != NULL && pg->neighbors != NULL
+	 && pg->matrices != NULL && next != NULL);
+
+  // count the edges of each player, then place them
+  for(e=0 ; e<ne ; e++) {
+    assert(edges[2*e] >= 0 && edges[2*e] < p);
+    assert(edges[2*e+1] >= 0 && edges[2*e+1] < p);
+    assert(edges[2*e] != edges[2*e+1]);
+    pg->first_edge[edges[2*e] + 1]++;
+  }
+  for(i=0 ; i<p ; i++) {
+    pg->first_edge[i+1] += pg->first_edge[i];
+    next[i] = pg->first_edge[i];
+  }
+  for(e=0 ; e<ne ; e++) {
+    pg->neighbors[next[edges[2*e]]++] = edges[2*e+1];
+  }
+  free(next);
+
+  for(i=0 ; i<p ; i++) {
+    qsort(pg->neighbors + pg->first_edge[i],
+	  pg->first_edge[i+1] - pg->first_edge[i], sizeof(int),
+	  polymatrix_compare_int);
+    for(e=pg->first_edge[i]+1 ; e<pg->first_edge[i+1] ; e++) {
+      // duplicate edge
+      assert(pg->neighbors[e] != pg->neighbors[e-1]);
+    }
+  }
+
+  return pg;
+}
+
+void gatha_polymatrix_game_free(GathaPolymatrixGame *pg)
+{
+  assert(pg != NULL);
+  free(pg->first_edge);
+  free(pg->neighbors);
+  free(pg->matrices);
+  free(pg);
+}
+
+static void polymatrix_game_expected_payoffs(GathaGame *g, int player,
+					     proba_t **proba, payoff_t *payoffs,
+					     int thread_id)
+{
+  gatha_polymatrix_game_expected_payoffs((GathaPolymatrixGame*) g->data,
+					 player, proba, payoffs);
+}
+
+GathaGame* gatha_game_from_polymatrix(GathaPolymatrixGame *pg)
+{
+  GathaGame *g;
+  assert(pg != NULL);
+  g = gatha_game_new(pg->n_players, pg->n_strategies);
+  g->payoff_func = gatha_polymatrix_game_payoffs;
+  g->expected_payoffs_func = polymatrix_game_expected_payoffs;
+  g->data = pg;
+  return g;
+}
+
+long gatha_polymatrix_game_edge(GathaPolymatrixGame *pg, int i, int j)
+{
+  long lo, hi, mid;
+
+  // binary search among the sorted neighbors of i
+  lo = pg->first_edge[i];
+  hi = pg->first_edge[i+1];
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (pg->neighbors[mid] < j) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo < pg->first_edge[i+1] && pg->neighbors[lo] == j) return lo;
+  return -1;
+}
+
+void gatha_polymatrix_game_set(GathaPolymatrixGame *pg, int i, int j,
+			       int a, int b, payoff_t value)
+{
+  long e;
+  int s;
+
+  e = gatha_polymatrix_game_edge(pg, i, j);
+  assert(e >= 0);
+  s = pg->n_strategies;
+  pg->matrices[e * s * s + b * s + a] = value;
+}
+
+payoff_t gatha_polymatrix_game_get(GathaPolymatrixGame *pg, int i, int j,
+				   int a, int b)
+{
+  long e;
+  int s;
+
+  e = gatha_polymatrix_game_edge(pg, i, j);
+  if (e < 0) return 0.0;
+  s = pg->n_strategies;
+  return pg->matrices[e * s * s + b * s + a];
+}
+
+void gatha_polymatrix_game_payoffs(GathaGame *g, int *actions,
+				   payoff_t *payoffs, int thread_id)
+{
+  GathaPolymatrixGame *pg;
+  int i, s;
+  long e, s2;
+  payoff_t sum;
+
+  pg = (GathaPolymatrixGame*) g->data;
+  s = pg->n_strategies;
+  s2 = (long) s * s;
+  for(i=0 ; i<pg->n_players ; i++) {
+    sum = 0.0;
+    for(e=pg->first_edge[i] ; e<pg->first_edge[i+1] ; e++) {
+      sum += pg->matrices[e * s2 + actions[pg->neighbors[e]] * s + actions[i]];
+    }
+    payoffs[i] = sum;
+  }
+}
+
+void gatha_polymatrix_game_expected_payoffs(GathaPolymatrixGame *pg,
+					    int player, proba_t **proba,
+					    payoff_t *payoffs)
+{
+  int a, s;
+  long e, s2;
+
+  assert(player >= 0 && player < pg->n_players);
+  s = pg->n_strategies;
+  s2 = (long) s * s;
+  for(a=0 ; a<s ; a++) {
+    payoffs[a] = 0.0;
+  }
+  for(e=pg->first_edge[player] ; e<pg->first_edge[player+1] ; e++) {
+    gatha_simd_weighted_rows_add(pg->matrices + e * s2, s,
+				 proba[pg->neighbors[e]], 1.0, s, s, payoffs);
+  }
+}
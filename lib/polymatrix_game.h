@@ -0,0 +1,84 @@
+#ifndef _GATHA_POLYMATRIX_GAME_H_
+#define _GATHA_POLYMATRIX_GAME_H_
+
+#include "types.h"
+
+/** Polymatrix game. Players are the nodes of a graph, and the payoff of a
+ *  player is the sum of the payoffs of bimatrix games against each of its
+ *  neighbors. Memory grows with the number of edges, not exponentially with
+ *  the number of players, so games with thousands of players can be stored.
+ *  The neighbors are stored in CSR (compressed sparse row) order. */
+struct _gatha_polymatrix_game {
+
+  /** Number of players in the game. */
+  int n_players;
+
+  /** Number of strategies for each player. */
+  int n_strategies;
+
+  /** Number of edges. An edge (i, j) means that the payoff of i depends on
+   * the strategy of j; (j, i) is a different edge, with its own matrix. */
+  long n_edges;
+
+  /** The edges of player i are the ones between first_edge[i] (included) and
+   * first_edge[i+1] (excluded). n_players+1 elements. */
+  long *first_edge;
+
+  /** Neighbor of each edge. The neighbors of a player are sorted. */
+  int *neighbors;
+
+  /** Payoff matrices of the edges, n_strategies^2 elements each:
+   * matrices[e*n_strategies^2 + b*n_strategies + a] is the payoff of player i
+   * choosing a, when its neighbor on edge e chooses b. The player's own
+   * strategy changes first, so that expected payoffs can be vectorized. */
+  payoff_t *matrices;
+} ;
+
+/** Creates a GathaPolymatrixGame, with all payoffs set to 0.
+ * @param np Number of players.
+ * @param ns Number of strategies for each player.
+ * @param ne Number of edges.
+ * @param edges The 2*ne players of the edges: edges[2*e] is the player whose
+ * payoff depends on player edges[2*e+1]. An edge must not appear twice.
+ */
+extern GathaPolymatrixGame* gatha_polymatrix_game_new(int np, int ns, long ne,
+						      const int *edges);
+
+/** Frees a GathaPolymatrixGame. */
+extern void gatha_polymatrix_game_free(GathaPolymatrixGame *pg);
+
+/** Creates a game using a polymatrix game for computing the payoffs. */
+extern GathaGame* gatha_game_from_polymatrix(GathaPolymatrixGame *pg);
+
+/** Returns the index of the edge (i, j), or -1 if there is no such edge. */
+extern long gatha_polymatrix_game_edge(GathaPolymatrixGame *pg, int i, int j);
+
+/** Sets the payoff of player i choosing a, when its neighbor j chooses b.
+ * The edge (i, j) must exist. */
+extern void gatha_polymatrix_game_set(GathaPolymatrixGame *pg, int i, int j,
+				      int a, int b, payoff_t value);
+
+/** Retrieves the payoff of player i choosing a, when its neighbor j chooses b.
+ * @returns The payoff, or 0 if there is no edge (i, j).
+ */
+extern payoff_t gatha_polymatrix_game_get(GathaPolymatrixGame *pg, int i, int j,
+					  int a, int b);
+
+/** Retrieves the players' payoffs for a choice of strategies. This is the
+ * payoff callback used by gatha_game_from_polymatrix.
+ * \see gatha_payoff_matrix_payoffs
+ */
+extern void gatha_polymatrix_game_payoffs(GathaGame *g, int *actions,
+					  payoff_t *payoffs, int thread_id);
+
+/** Computes the exact expected payoff of each strategy of a player, when the
+ * other players choose their strategies according to their probability vectors.
+ * The expectation is the sum of one matrix-vector product per neighbor:
+ * O(degree * n_strategies^2).
+ * \see gatha_payoff_matrix_expected_payoffs
+ */
+extern void gatha_polymatrix_game_expected_payoffs(GathaPolymatrixGame *pg,
+						   int player, proba_t **proba,
+						   payoff_t *payoffs);
+
+#endif /* _GATHA_POLYMATRIX_GAME_H_ */
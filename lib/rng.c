@@ -0,0 +1,32 @@
+#include "rng.h"
+
+static inline uint64_t rng_splitmix64(uint64_t *x)
+{
+  uint64_t z;
+
+  z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+void gatha_rng_seed(GathaRng *r, uint64_t seed)
+{
+  int i;
+
+  for(i=0 ; i<4 ; i++) {
+    r->s[i] = rng_splitmix64(&seed);
+  }
+}
+
+void gatha_rng_seed_stream(GathaRng *r, uint64_t seed, uint64_t a,
+			   uint64_t b, uint64_t c)
+{
+  uint64_t x;
+
+  x = c;
+  x = rng_splitmix64(&x) ^ b;
+  x = rng_splitmix64(&x) ^ a;
+  x = rng_splitmix64(&x) ^ seed;
+  gatha_rng_seed(r, rng_splitmix64(&x));
+}
@@ -0,0 +1,56 @@
+#ifndef _GATHA_RNG_H_
+#define _GATHA_RNG_H_
+
+#include "types.h"
+
+#include <stdint.h>
+
+/** State of a xoshiro256** pseudo-random number generator, by Blackman and
+ *  Vigna. It is small and fast, and passes the usual statistical tests. The
+ *  algorithms do not share the state of rand(): MCB derives a generator from
+ *  (seed, iteration, player and strategy, chunk) for each piece of work with
+ *  gatha_rng_seed_stream, SFP one per iteration, and Sastry seeds a single
+ *  one, so the results do not depend on the threads. */
+struct _gatha_rng {
+  uint64_t s[4];
+} ;
+
+/** Seeds a generator. The state is filled with splitmix64, so that close
+ * seeds give unrelated sequences. */
+extern void gatha_rng_seed(GathaRng *r, uint64_t seed);
+
+/** Seeds a generator from a seed and three counters, for example an
+ * iteration, a player and a simulation. The counters are hashed with the
+ * seed, so that the sequence of a piece of work only depends on which piece
+ * it is, not on the thread that does it or on the order of the work. */
+extern void gatha_rng_seed_stream(GathaRng *r, uint64_t seed, uint64_t a,
+				  uint64_t b, uint64_t c);
+
+static inline uint64_t gatha_rng_rotl(uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}
+
+/** Returns the next 64 random bits of a generator. */
+static inline uint64_t gatha_rng_next(GathaRng *r)
+{
+  uint64_t result, t;
+
+  result = gatha_rng_rotl(r->s[1] * 5, 7) * 9;
+  t = r->s[1] << 17;
+  r->s[2] ^= r->s[0];
+  r->s[3] ^= r->s[1];
+  r->s[1] ^= r->s[2];
+  r->s[0] ^= r->s[3];
+  r->s[2] ^= t;
+  r->s[3] = gatha_rng_rotl(r->s[3], 45);
+  return result;
+}
+
+/** Returns a number drawn uniformly in [0, 1). */
+static inline double gatha_rng_uniform(GathaRng *r)
+{
+  return (gatha_rng_next(r) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+#endif /* _GATHA_RNG_H_ */
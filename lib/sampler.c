@@ -0,0 +1,93 @@
+#include "sampler.h"
+#include "game.h"
+
+GathaSampler* gatha_sampler_new(GathaGame *g)
+{
+  GathaSampler *s;
+
+  assert(g != NULL);
+  s = (GathaSampler*) malloc(sizeof(GathaSampler));
+  if (s == NULL) return NULL;
+
+  s->n_players = g->n_players;
+  s->n_strategies = g->n_strategies;
+  s->tables = (GathaSamplerEntry*) malloc((long) g->n_players * g->n_strategies
+					  * sizeof(GathaSamplerEntry));
+  s->scaled = (double*) malloc(g->n_strategies * sizeof(double));
+  s->work = (int*) malloc(g->n_strategies * sizeof(int));
+  assert(s->tables != NULL && s->scaled != NULL && s->work != NULL);
+
+  return s;
+}
+
+void gatha_sampler_free(GathaSampler *s)
+{
+  assert(s != NULL);
+  free(s->tables);
+  free(s->scaled);
+  free(s->work);
+  free(s);
+}
+
+void gatha_sampler_build_player(GathaSampler *s, int player,
+				const proba_t *proba)
+{
+  int i, m, n_small, n_large, l, g, last;
+  double sum;
+  GathaSamplerEntry *t;
+
+  m = s->n_strategies;
+  t = s->tables + (long) player * m;
+
+  sum = 0.0;
+  last = -1;
+  for(i=0 ; i<m ; i++) {
+    sum += proba[i];
+    if (proba[i] > 0.0) last = i;
+  }
+  assert(last != -1);
+
+  // sort the columns into those below and above the average
+  n_small = 0;
+  n_large = 0;
+  for(i=0 ; i<m ; i++) {
+    s->scaled[i] = proba[i] * m / sum;
+    if (s->scaled[i] < 1.0) s->work[n_small++] = i;
+    else s->work[m - 1 - n_large++] = i;
+  }
+
+  // fill each small column with a large one
+  while (n_small > 0 && n_large > 0) {
+    l = s->work[--n_small];
+    g = s->work[m - n_large];
+    t[l].threshold = s->scaled[l];
+    t[l].alias = g;
+    s->scaled[g] -= 1.0 - s->scaled[l];
+    if (s->scaled[g] < 1.0) {
+      n_large--;
+      s->work[n_small++] = g;
+    }
+  }
+
+  // the columns left are full, up to rounding errors; a strategy of
+  // probability 0 is sent to one that can be chosen
+  while (n_large > 0) {
+    g = s->work[m - n_large--];
+    t[g].threshold = 1.0;
+    t[g].alias = g;
+  }
+  while (n_small > 0) {
+    l = s->work[--n_small];
+    t[l].threshold = (proba[l] > 0.0) ? 1.0 : 0.0;
+    t[l].alias = (proba[l] > 0.0) ? l : last;
+  }
+}
+
+void gatha_sampler_build(GathaSampler *s, proba_t **proba)
+{
+  int i;
+
+  for(i=0 ; i<s->n_players ; i++) {
+    gatha_sampler_build_player(s, i, proba[i]);
+  }
+}
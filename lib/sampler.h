@@ -0,0 +1,71 @@
+#ifndef _GATHA_SAMPLER_H_
+#define _GATHA_SAMPLER_H_
+
+#include "types.h"
+#include "rng.h"
+
+/** Entry of an alias table: the column is drawn with probability
+ * `threshold', and `alias' otherwise. They are kept together so that a draw
+ * reads a single cache line. */
+typedef struct {
+  proba_t threshold;
+  int alias;
+} GathaSamplerEntry;
+
+/** Draws the strategies of all the players in O(1), with one alias table
+ *  (Walker, Vose) per player. Building the tables takes O(m) per player, so
+ *  it pays when many strategies are drawn against the same probability
+ *  vector: the tables are built once per iteration, and all the draws of the
+ *  iteration use them. Several threads can draw at the same time, each with
+ *  its own generator. */
+struct _gatha_sampler {
+  /** Number of players. */
+  int n_players;
+
+  /** Number of strategies. */
+  int n_strategies;
+
+  /** Alias tables, n_strategies entries for each player. */
+  GathaSamplerEntry *tables;
+
+  /** Scaled probabilities used while building a table. */
+  double *scaled;
+
+  /** Work list used while building a table: the columns below the average
+   * from the start, and the others from the end. */
+  int *work;
+} ;
+
+/** Creates a sampler for the players of a game. The tables have to be built
+ * with gatha_sampler_build before drawing. */
+extern GathaSampler* gatha_sampler_new(GathaGame *g);
+
+/** Frees a sampler. */
+extern void gatha_sampler_free(GathaSampler *s);
+
+/** Builds the alias table of a player. The probabilities do not need to add
+ * up to exactly 1; strategies of probability 0 are never drawn. */
+extern void gatha_sampler_build_player(GathaSampler *s, int player,
+				       const proba_t *proba);
+
+/** Builds the alias tables of all the players from their probability
+ * vectors. */
+extern void gatha_sampler_build(GathaSampler *s, proba_t **proba);
+
+/** Draws a strategy of a player, using a single random number. */
+static inline int gatha_sampler_draw(GathaSampler *s, int player,
+				     GathaRng *rng)
+{
+  uint64_t r;
+  int i;
+  const GathaSamplerEntry *e;
+
+  // the high bits choose the column, the low ones decide against the alias
+  r = gatha_rng_next(rng);
+  i = (int) (((r >> 32) * (uint64_t) s->n_strategies) >> 32);
+  e = s->tables + (long) player * s->n_strategies + i;
+  if ((r & 0xffffffffULL) * (1.0 / 4294967296.0) < e->threshold) return i;
+  return e->alias;
+}
+
+#endif /* _GATHA_SAMPLER_H_ */
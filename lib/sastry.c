@@ -1,4 +1,6 @@
 #include "sastry.h"
+#include "simd.h"
+#include "rng.h"
 
 GathaSastryData* gatha_sastry_data_new(GathaGame *g)
 {
@@ -13,6 +15,8 @@ GathaSastryData* gatha_sastry_data_new(GathaGame *g)
   d->b = 0.01;
   d->time = -1;
   d->max_time = -1;
+  d->proba_init = NULL;
+  d->seed = 1;
   d->checkpoint_dir = NULL;
   d->save_interval = 1000;
 
@@ -32,68 +36,29 @@ void gatha_sastry_data_free(GathaSastryData *d)
     free(d);
 }
 
-inline void sastry_update_proba(int player, int action,
-				payoff_t payoff,
-				GathaSastryData *data)
+static inline int sastry_draw(GathaSastryData *data, int player, GathaRng *rng)
 {
-  int i, m;
-  proba_t x;
-  proba_t *proba;
-  int c=0;
-
-  m = data->game->n_strategies;
-  proba = data->proba[player];
-
-  /* check how many strategies have non-zero probability */
-  for(i=0 ; i<m ; i++) {
-    if((proba[i] > 0.0))
-      c++;
-  }
-  assert(c > 0);
-
-  if(c != 0) {
-    /* how much should we add to the probability of
-       choosing this action? */
-    x = (data->b * payoff * (1.0-proba[action]));
-    proba[action] += x;
-
-    /* remove that amount from the other probabilities */
-    x /= c;
-    for(i=0 ; i<m ; i++) {
-      if( i!=action &&  proba[i]>0.0) {
-	proba[i] = proba[i] - x;
-	if (proba[i] < 0.0) proba[i] = 0.0;
-      }
-    }
-  }		
-
-}
-
-inline int sastry_draw(GathaSastryData *data, int player)
-{
-  proba_t result;
+  double result;
   proba_t b_sup;
   proba_t *T;
-  int i, n, c;
+  int i, n;
 
   n = data->game->n_strategies;
   T = data->proba[player];
 
-  // sometimes, due to rounding errors, the for loop
-  // below may fail to pick a strategy, so we try it
-  // 3 times.
-  c = 0;
-  while (c<3) {
-    result = (proba_t)rand()/RAND_MAX;
-    
-    b_sup = T[0];
-    for(i=0;i<n;i++) {
-      if( result < b_sup ) {
-	return i;
-      }
-      b_sup = b_sup + T[i+1];
+  result = gatha_rng_uniform(rng);
+  b_sup = 0.0;
+  for(i=0;i<n;i++) {
+    b_sup += T[i];
+    if( result < b_sup ) {
+      return i;
     }
-    c++;
+  }
+
+  // due to rounding errors, the probabilities may add up to a bit less than
+  // result: the last strategy that can be chosen is picked
+  for(i=n-1 ; i>=0 ; i--) {
+    if (T[i] > 0.0) return i;
   }
 
   assert(FALSE);
@@ -190,6 +155,7 @@ void gatha_sastry(GathaSastryData *data)
   int *actions;
   payoff_t *payoffs;
   boolean stop;
+  GathaRng rng;
 
   assert(data != NULL);
   assert(data->game != NULL);
@@ -210,6 +176,8 @@ void gatha_sastry(GathaSastryData *data)
   payoffs = (payoff_t*) calloc(n, sizeof(payoff_t));
   assert(payoffs != NULL);
 
+  gatha_rng_seed(&rng, data->seed);
+
   data->time = 0;
   stop = FALSE;
   while (stop == FALSE && (data->max_time == -1 ||
@@ -224,15 +192,15 @@ void gatha_sastry(GathaSastryData *data)
       }
 
       for(i=0 ; i<n ; i++) {
-	actions[i] = sastry_draw(data, i);
+	actions[i] = sastry_draw(data, i, &rng);
       }
       
       data->game->payoff_func(data->game, actions, payoffs, 0);
       
       for(i=0 ; i<n ; i++) {
-	sastry_update_proba(i, actions[i], payoffs[i], data);
+	gatha_simd_lri_update(data->proba[i], m, actions[i],
+			      data->b * payoffs[i]);
       }
-      gatha_game_pvect_normalize(data->game, data->proba);
 
       if (data->convergence_func != NULL) {
 	stop = data->convergence_func(payoffs,
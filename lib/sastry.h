@@ -32,6 +32,10 @@ struct _gatha_sastry_data {
    * `gatha_sastry' will initialize the vector with uniform probability. */
   void (*proba_init)(GathaGame* g, proba_t **p);
 
+  /** Seed of the random number generator used to draw the strategies. Two
+   * runs with the same seed and parameters give the same results. */
+  unsigned long seed;
+
   char* checkpoint_dir;
   int save_interval;
 
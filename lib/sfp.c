@@ -1,4 +1,8 @@
 #include "sfp.h"
+#include "rng.h"
+#include "sampler.h"
+
+#include <omp.h>
 
 #define FILENAME_MAX_LENGTH 256
 
@@ -19,8 +23,12 @@ GathaSfpData* gatha_sfp_data_new(GathaGame *g)
 
   d->max_thread = 4;
   d->sampling_size = 100;
+  d->sim_chunk = 100;
+  d->exact_expectation = FALSE;
   d->time = -1;
   d->max_time = -1;
+  d->proba_init = NULL;
+  d->seed = 1;
   d->checkpoint_dir = NULL;
   d->save_interval = 1000;
 
@@ -70,42 +78,14 @@ static inline void sfp_update_proba(int player, int action,
 
 }
 
-static inline int sfp_draw(GathaSfpData *data, int player)
-{
-  proba_t result;
-  proba_t b_sup;
-  proba_t *T;
-  int i, n, c;
-
-  n = data->game->n_strategies;
-  T = data->proba[player];
-
-  // sometimes, due to rounding errors, the for loop
-  // below may fail to pick a strategy, so we try it
-  // 3 times.
-  c = 0;
-  while (c<3) {
-    result = (proba_t)rand()/RAND_MAX;
-
-    b_sup = T[0];
-    for(i=0;i<n;i++) {
-      if( result < b_sup ) {
-	return i;
-      }
-      b_sup = b_sup + T[i+1];
-    }
-  }
-
-  assert(FALSE);
-  return -1;
-}
-
-static inline int sfp_one_step(GathaSfpData *data, int player, int *actions,
+static inline int sfp_one_step(GathaSfpData *data, int player, int *profiles,
 			       payoff_t *payoffs, payoff_t *payoff_tmp,
 			       int **sample,
 			       int thread_id)
 {
-  int i, j, k, p, n, ss;
+  int i, j, k, p, n, ss, c;
+  long first, count, total_count;
+  int *actions;
   int best_action;
   payoff_t best_payoff;
   payoff_t sum, total;
@@ -118,29 +98,53 @@ static inline int sfp_one_step(GathaSfpData *data, int player, int *actions,
   n = data->game->n_strategies;
   ss = data->sampling_size;
 
-  /* compute the best answer with regards to the sample */
+  /* compute the best answer with regards to the probability vectors */
+  if (data->exact_expectation &&
+      gatha_game_expected_payoffs(data->game, player, data->proba,
+				  payoff_tmp, thread_id)) {
+    for(i=0 ; i<n ; i++) {
+      if (payoff_tmp[i] > best_payoff || best_action == -1) {
+	best_action = i;
+	best_payoff = payoff_tmp[i];
+      }
+    }
+    return best_action;
+  }
+
+  /* evaluate every action against the whole sample, in batches of at most
+     sim_chunk choices: choice c is action c / ss against sample c % ss */
   for(i=0 ; i<n ; i++) {
+    payoff_tmp[i] = 0.0;
+  }
+  total_count = (long) n * ss;
+  for(first=0 ; first<total_count ; first+=count) {
+    count = total_count - first;
+    if (count > data->sim_chunk) count = data->sim_chunk;
     // TODO: add forbidden actions
-
-    actions[player] = i;
-
-    sum = 0.0;
-    for(j=0 ; j<ss ; j++) {
+    for(c=0 ; c<count ; c++) {
+      i = (first + c) / ss;
+      j = (first + c) % ss;
+      actions = profiles + c * p;
       for(k=0 ; k<p ; k++) {
-	if (k == player) continue;
-	actions[k] = sample[j][k];
+	actions[k] = (k == player) ? i : sample[j][k];
       }
-      data->game->payoff_func(data->game, actions, payoffs, thread_id);
-      //sum += log(1.0+payoffs[player]);
-      sum += payoffs[player];
     }
-    sum /= ss;
+    gatha_game_payoffs_batch(data->game, profiles, count, payoffs, thread_id);
+    for(c=0 ; c<count ; c++) {
+      //payoff_tmp[i] += log(1.0+payoffs[c*p + player]);
+      payoff_tmp[(first + c) / ss] += payoffs[c * p + player];
+    }
+  }
+
+  /* compute the best answer with regards to the sample */
+  for(i=0 ; i<n ; i++) {
+    sum = payoff_tmp[i] / ss;
     //costs_tmp[i] = 1.0/sum;
     payoff_tmp[i] = sum;
     total += payoff_tmp[i];
 
     if (sum > best_payoff || best_action == -1) {
-      best_action = actions[player];
+      best_action = i;
       best_payoff = sum;
     }
   }
@@ -204,14 +208,18 @@ void gatha_sfp(GathaSfpData *data)
   boolean stop;
   int thread_id;
 
-  /* payoff arrays, one for each thread */
-  payoff_t **payoffs_a;
-  /* payoff tmp arrays, one for each thread */
-  payoff_t **payoffs_tmp;
-  /* action arrays, one for each thread */
-  int **actions_a;
+  /* scratch arrays of a thread: strategy choices and payoffs of a sample
+     batch, and payoffs of its strategies for a player */
+  int *profiles;
+  payoff_t *batch_payoffs;
+  payoff_t *payoff_tmp;
+  /* number of strategy choices in a batch */
+  int batch;
 
   int **sample;
+  boolean exact;
+  GathaRng rng;
+  GathaSampler *sampler;
 
   assert(data != NULL);
   assert(data->game != NULL);
@@ -220,6 +228,8 @@ void gatha_sfp(GathaSfpData *data)
   n = data->game->n_players;
   m = data->game->n_strategies;
   ss = data->sampling_size;
+  exact = data->exact_expectation &&
+    gatha_game_has_expected_payoffs(data->game);
 
   if (data->proba_init != NULL) {
     data->proba_init(data->game, data->proba, data->action_count);
@@ -254,100 +264,125 @@ void gatha_sfp(GathaSfpData *data)
   payoffs = (payoff_t*) calloc(n, sizeof(payoff_t));
   assert(payoffs != NULL);
 
-  /* initialize the action and costs temp arrays used in the different
-     threads */
-  actions_a = (int**)malloc(data->max_thread*sizeof(int*));
-  payoffs_a = (payoff_t**)malloc(data->max_thread*sizeof(payoff_t*));
-  payoffs_tmp = (payoff_t**)malloc(data->max_thread*sizeof(payoff_t*));
-  for(i=0 ; i<data->max_thread ; i++) {
-    actions_a[i] = (int*)malloc(n*sizeof(int));
-    payoffs_a[i] = (payoff_t*)malloc(n*sizeof(payoff_t));
-    payoffs_tmp[i] = (payoff_t*)malloc(m*sizeof(payoff_t));
-  }
+  assert(data->max_thread > 0);
+  assert(data->sim_chunk > 0);
+  batch = (data->sim_chunk < (long) m * ss) ? data->sim_chunk : m * ss;
+  if (exact) batch = 1;
   sample = (int**) malloc(data->sampling_size * sizeof(int*));
   for(i=0 ; i<ss ; i++) {
     sample[i] = (int*) malloc(n*sizeof(int));
   }
+  sampler = gatha_sampler_new(data->game);
 
   data->time = 0;
   stop = FALSE;
-  while (stop == FALSE && (data->max_time == -1 ||
-			   data->time < data->max_time)
-	 )
-    {
-      if (data->time % data->save_interval == 0 && data->checkpoint_dir != NULL) {
-	sfp_save_checkpoint(data, actions, payoffs);
-      }
 
-      if (data->feedback_func != NULL && data->time % data->feedback_interval == 0) {
-	data->feedback_func(data, actions, payoffs, data->feedback_data);
-      }
-      
-      /* draws a new sample */
-      for(i=0 ; i<ss ; i++) {
-	/* for each player, draw a strategy */
-	for(j=0 ; j<n ; j++) {
-	  sample[i][j] = sfp_draw(data, j);
+  /* the threads live for the whole run: the serial steps are done by one of
+     them while the others wait at the barrier that ends them */
+  #pragma omp parallel num_threads(data->max_thread) \
+    private(thread_id, i, j, profiles, batch_payoffs, payoff_tmp)
+  {
+    thread_id = omp_get_thread_num();
+
+    /* each thread allocates its own scratch arrays, so that they are near
+       it and do not share cache lines with those of the others */
+    profiles = (int*) gatha_aligned_malloc(batch * n * sizeof(int));
+    batch_payoffs = (payoff_t*) gatha_aligned_malloc(batch * n
+						     * sizeof(payoff_t));
+    payoff_tmp = (payoff_t*) gatha_aligned_malloc(m * sizeof(payoff_t));
+    assert(profiles != NULL && batch_payoffs != NULL && payoff_tmp != NULL);
+
+    while (stop == FALSE && (data->max_time == -1 ||
+			     data->time < data->max_time)
+	   )
+      {
+	#pragma omp single
+	{
+	  /* the probability vectors changed in the last update, and do not
+	     change again until the next one */
+	  if (exact)
+	    gatha_game_expected_payoffs_prepare(data->game, data->proba);
+
+	  if (data->time % data->save_interval == 0 && data->checkpoint_dir != NULL) {
+	    sfp_save_checkpoint(data, actions, payoffs);
+	  }
+
+	  if (data->feedback_func != NULL && data->time % data->feedback_interval == 0) {
+	    data->feedback_func(data, actions, payoffs, data->feedback_data);
+	  }
+
+	  /* draws a new sample, unless the players use exact expectations */
+	  if (!exact) {
+	    gatha_rng_seed_stream(&rng, data->seed, data->time, 0, 0);
+	    gatha_sampler_build(sampler, data->proba);
+	    for(i=0 ; i<ss ; i++) {
+	      /* for each player, draw a strategy */
+	      for(j=0 ; j<n ; j++) {
+		sample[i][j] = gatha_sampler_draw(sampler, j, &rng);
+	      }
+	    }
+	  }
 	}
-      }
 
-      #pragma omp parallel for private(thread_id)
-      for(i=0 ; i<n ; i++) {
-	thread_id = omp_get_thread_num();
-	actions[i] = sfp_one_step(data, i, actions_a[thread_id],
-				  payoffs_a[thread_id],
-				  payoffs_tmp[thread_id],
-				  sample,
-				  thread_id);
-      }
-      
-      data->game->payoff_func(data->game, actions, payoffs, 0);
-      
-      for(i=0 ; i<n ; i++) {
-	sfp_update_proba(i, actions[i], payoffs[i], data);
-      }
-      gatha_game_pvect_normalize(data->game, data->proba);
+	#pragma omp for
+	for(i=0 ; i<n ; i++) {
+	  actions[i] = sfp_one_step(data, i, profiles, batch_payoffs,
+				    payoff_tmp, sample, thread_id);
+	}
+
+	#pragma omp single
+	{
+	  data->game->payoff_func(data->game, actions, payoffs, thread_id);
+
+	  /* the update does not change the payoffs, so the convergence can be
+	     checked first */
+	  if (data->convergence_func != NULL) {
+	    stop = data->convergence_func(payoffs,
+					  data->convergence_data);
+	  }
+	  data->time++;
+	}
 
-      if (data->convergence_func != NULL) {
-	stop = data->convergence_func(payoffs,
-				      data->convergence_data);
+	#pragma omp for
+	for(i=0 ; i<n ; i++) {
+	  sfp_update_proba(i, actions[i], payoffs[i], data);
+	  gatha_game_pvect_normalize_player(data->game, data->proba, i);
+	}
+
+	/* show the action counts */
+	/* printf("Iteration %d\n", data->time); */
+	/* printf(" Action counts\n"); */
+	/* for(i=0 ; i<n ; i++) { */
+	/* 	printf("  Player %d: ", i); */
+	/* 	for(j=0 ; j<m ; j++) { */
+	/* 	  printf("%2d ", data->action_count[i][j]); */
+	/* 	} */
+	/* 	printf("\n"); */
+	/* } */
+	/* printf(" Probabilities\n"); */
+	/* for(i=0 ; i<n ; i++) { */
+	/* 	printf("  Player %d: ", i); */
+	/* 	for(j=0 ; j<m ; j++) { */
+	/* 	  printf("%.2f ", data->proba[i][j]); */
+	/* 	} */
+	/* 	printf("\n") */;
+	/* } */
       }
 
-      /* show the action counts */
-      /* printf("Iteration %d\n", data->time); */
-      /* printf(" Action counts\n"); */
-      /* for(i=0 ; i<n ; i++) { */
-      /* 	printf("  Player %d: ", i); */
-      /* 	for(j=0 ; j<m ; j++) { */
-      /* 	  printf("%2d ", data->action_count[i][j]); */
-      /* 	} */
-      /* 	printf("\n"); */
-      /* } */
-      /* printf(" Probabilities\n"); */
-      /* for(i=0 ; i<n ; i++) { */
-      /* 	printf("  Player %d: ", i); */
-      /* 	for(j=0 ; j<m ; j++) { */
-      /* 	  printf("%.2f ", data->proba[i][j]); */
-      /* 	} */
-      /* 	printf("\n") */;
-      /* } */
-
-      data->time++;
-    }
+    free(profiles);
+    free(batch_payoffs);
+    free(payoff_tmp);
+  }
 
   /* free the temp arrays we created */
   for(i=0 ; i<ss ; i++) {
     free(sample[i]);
   }
   free(sample);
-  for(i=0 ; i<data->max_thread ; i++) {
-    free(actions_a[i]);
-    free(payoffs_a[i]);
-    free(payoffs_tmp[i]);
-  }
-  free(actions_a);
-  free(payoffs_a);
-  free(payoffs_tmp);
+  /* the last update changed the vectors after the last preparation */
+  if (exact) gatha_game_expected_payoffs_prepare(data->game, NULL);
+
+  gatha_sampler_free(sampler);
   free(actions);
   free(payoffs);
 }
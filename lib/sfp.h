@@ -30,6 +30,12 @@ struct _gatha_sfp_data {
    * `gatha_mcb' will initialize the vector with uniform probability. */
   void (*proba_init)(GathaGame* g, proba_t **p, int **counts);
 
+  /** Seed of the random number generator used to draw the samples. The
+   * sample of an iteration uses a generator derived from the seed and the
+   * iteration, so that a run gives the same results whatever the number of
+   * threads. */
+  unsigned long seed;
+
   char* checkpoint_dir;
   int save_interval;
 
@@ -44,7 +50,28 @@ struct _gatha_sfp_data {
   /** Sampling size */
   int sampling_size;
 
-  /** Maximum number of threads to start */
+  /** Maximum number of strategy choices evaluated in one batch. Each
+   * strategy of a player is tried against the whole sample, and these
+   * n_strategies * `sampling_size' choices are evaluated in batches of
+   * `sim_chunk', so that the scratch arrays of each thread stay small
+   * whatever the size of the game. Larger batches suit
+   * GathaGame::payoff_batch_func better. 100 by default; the results do not
+   * depend on it. */
+  int sim_chunk;
+
+  /** If TRUE, and if the game can compute exact expected payoffs (see
+   * GathaGame::expected_payoffs_func), the best answer is computed against
+   * the probability vectors themselves instead of a sample of
+   * `sampling_size' strategy choices. This changes the dynamics of the
+   * algorithm, so it is FALSE by default. */
+  boolean exact_expectation;
+
+  /** Maximum number of threads to start, 4 by default. `gatha_sfp' runs with
+   * at most this many threads, so the thread ids given to the payoff
+   * callbacks are lower (see gatha_payoff_cache_new). Each thread allocates
+   * its own scratch arrays. Where the threads run is set with the usual
+   * OpenMP variables, for example OMP_PROC_BIND=close and OMP_PLACES=cores.
+   */
   int max_thread;
 
   /** Feedback interval */
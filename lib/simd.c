@@ -0,0 +1,415 @@
+#include "simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define GATHA_SIMD_X86 1
+# include <immintrin.h>
+#endif
+
+/* --- scalar kernels --- */
+
+static void weighted_rows_scalar(const payoff_t *rows, long stride,
+				 const proba_t *w, payoff_t scale,
+				 int n_rows, int m, payoff_t *out)
+{
+  int a, r;
+  payoff_t x;
+  const payoff_t *row;
+
+  for(r=0 ; r<n_rows ; r++) {
+    if (w[r] == 0.0) continue;
+    x = scale * w[r];
+    row = rows + r * stride;
+    for(a=0 ; a<m ; a++) {
+      out[a] += x * row[a];
+    }
+  }
+}
+
+static void lri_update_scalar(proba_t *p, int m, int action, payoff_t step)
+{
+  int i, c;
+  proba_t x, sum;
+
+  c = 0;
+  for(i=0 ; i<m ; i++) {
+    if (p[i] > 0.0) c++;
+  }
+  assert(c > 0);
+
+  x = step * (1.0 - p[action]);
+  p[action] += x;
+  x /= c;
+  sum = 0;
+  for(i=0 ; i<m ; i++) {
+    if (i != action && p[i] > 0.0) {
+      p[i] = p[i] - x;
+      if (p[i] < 0.0) p[i] = 0.0;
+    }
+    sum += p[i];
+  }
+  for(i=0 ; i<m ; i++) {
+    p[i] /= sum;
+  }
+}
+
+#ifdef GATHA_SIMD_X86
+
+/* --- SSE2 kernels --- */
+
+/* the vector kernels zero the chosen strategy during the update pass, so that
+   it is left alone like the strategies of probability 0, and set it after */
+__attribute__((target("sse2")))
+static void lri_update_sse2(proba_t *p, int m, int action, payoff_t step)
+{
+  int i, c;
+  proba_t x, pa, sum, s[4];
+  __m128 v, t, gt, vx, zero, vsum;
+
+  zero = _mm_setzero_ps();
+  c = 0;
+  for(i=0 ; i+4<=m ; i+=4) {
+    gt = _mm_cmpgt_ps(_mm_loadu_ps(p+i), zero);
+    c += __builtin_popcount(_mm_movemask_ps(gt));
+  }
+  for( ; i<m ; i++) {
+    if (p[i] > 0.0) c++;
+  }
+  assert(c > 0);
+
+  x = step * (1.0 - p[action]);
+  pa = p[action] + x;
+  x /= c;
+  p[action] = 0.0;
+
+  vx = _mm_set1_ps(x);
+  vsum = zero;
+  for(i=0 ; i+4<=m ; i+=4) {
+    v = _mm_loadu_ps(p+i);
+    gt = _mm_cmpgt_ps(v, zero);
+    t = _mm_max_ps(_mm_sub_ps(v, vx), zero);
+    v = _mm_or_ps(_mm_and_ps(gt, t), _mm_andnot_ps(gt, v));
+    _mm_storeu_ps(p+i, v);
+    vsum = _mm_add_ps(vsum, v);
+  }
+  _mm_storeu_ps(s, vsum);
+  sum = (s[0] + s[1]) + (s[2] + s[3]);
+  for( ; i<m ; i++) {
+    if (p[i] > 0.0) {
+      p[i] = p[i] - x;
+      if (p[i] < 0.0) p[i] = 0.0;
+    }
+    sum += p[i];
+  }
+  p[action] = pa;
+  sum += pa;
+
+  vsum = _mm_set1_ps(sum);
+  for(i=0 ; i+4<=m ; i+=4) {
+    _mm_storeu_ps(p+i, _mm_div_ps(_mm_loadu_ps(p+i), vsum));
+  }
+  for( ; i<m ; i++) {
+    p[i] /= sum;
+  }
+}
+
+/* --- AVX2 kernels --- */
+
+/* the rows are streamed four at a time, so that `out', which stays in the
+   cache, is only read and written once for every four rows */
+__attribute__((target("avx2,fma")))
+static void weighted_rows_avx2(const payoff_t *rows, long stride,
+			       const proba_t *w, payoff_t scale,
+			       int n_rows, int m,
+			       payoff_t *out)
+{
+  int a, r, k;
+  const payoff_t *row[4];
+  payoff_t x[4];
+  __m256d o, x0, x1, x2, x3;
+
+  r = 0;
+  while (r < n_rows) {
+    /* gather the next four rows with a non-zero weight */
+    for(k=0 ; k<4 && r<n_rows ; r++) {
+      if (w[r] == 0.0) continue;
+      x[k] = scale * w[r];
+      row[k] = rows + r * stride;
+      k++;
+    }
+    for( ; k<4 ; k++) {
+      x[k] = 0.0;
+      row[k] = row[0];
+    }
+    if (x[0] == 0.0) break;
+
+    x0 = _mm256_set1_pd(x[0]);
+    x1 = _mm256_set1_pd(x[1]);
+    x2 = _mm256_set1_pd(x[2]);
+    x3 = _mm256_set1_pd(x[3]);
+    for(a=0 ; a+4<=m ; a+=4) {
+      o = _mm256_loadu_pd(out+a);
+      o = _mm256_fmadd_pd(x0, _mm256_loadu_pd(row[0]+a), o);
+      o = _mm256_fmadd_pd(x1, _mm256_loadu_pd(row[1]+a), o);
+      o = _mm256_fmadd_pd(x2, _mm256_loadu_pd(row[2]+a), o);
+      o = _mm256_fmadd_pd(x3, _mm256_loadu_pd(row[3]+a), o);
+      _mm256_storeu_pd(out+a, o);
+    }
+    for( ; a<m ; a++) {
+      out[a] += x[0] * row[0][a] + x[1] * row[1][a]
+	+ x[2] * row[2][a] + x[3] * row[3][a];
+    }
+  }
+}
+
+__attribute__((target("avx2")))
+static void lri_update_avx2(proba_t *p, int m, int action, payoff_t step)
+{
+  int i, c;
+  proba_t x, pa, sum;
+  __m256 v, t, gt, vx, zero, vsum;
+  __m128 h;
+
+  zero = _mm256_setzero_ps();
+  c = 0;
+  for(i=0 ; i+8<=m ; i+=8) {
+    gt = _mm256_cmp_ps(_mm256_loadu_ps(p+i), zero, _CMP_GT_OQ);
+    c += __builtin_popcount(_mm256_movemask_ps(gt));
+  }
+  for( ; i<m ; i++) {
+    if (p[i] > 0.0) c++;
+  }
+  assert(c > 0);
+
+  x = step * (1.0 - p[action]);
+  pa = p[action] + x;
+  x /= c;
+  p[action] = 0.0;
+
+  vx = _mm256_set1_ps(x);
+  vsum = zero;
+  for(i=0 ; i+8<=m ; i+=8) {
+    v = _mm256_loadu_ps(p+i);
+    gt = _mm256_cmp_ps(v, zero, _CMP_GT_OQ);
+    t = _mm256_max_ps(_mm256_sub_ps(v, vx), zero);
+    v = _mm256_blendv_ps(v, t, gt);
+    _mm256_storeu_ps(p+i, v);
+    vsum = _mm256_add_ps(vsum, v);
+  }
+  h = _mm_add_ps(_mm256_castps256_ps128(vsum), _mm256_extractf128_ps(vsum, 1));
+  h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+  sum = _mm_cvtss_f32(_mm_add_ss(h, _mm_shuffle_ps(h, h, 1)));
+  for( ; i<m ; i++) {
+    if (p[i] > 0.0) {
+      p[i] = p[i] - x;
+      if (p[i] < 0.0) p[i] = 0.0;
+    }
+    sum += p[i];
+  }
+  p[action] = pa;
+  sum += pa;
+
+  vsum = _mm256_set1_ps(sum);
+  for(i=0 ; i+8<=m ; i+=8) {
+    _mm256_storeu_ps(p+i, _mm256_div_ps(_mm256_loadu_ps(p+i), vsum));
+  }
+  for( ; i<m ; i++) {
+    p[i] /= sum;
+  }
+}
+
+/* --- AVX-512 kernels --- */
+
+__attribute__((target("avx512f")))
+static void weighted_rows_avx512(const payoff_t *rows, long stride,
+				 const proba_t *w, payoff_t scale,
+				 int n_rows, int m,
+				 payoff_t *out)
+{
+  int a, r, k;
+  const payoff_t *row[4];
+  payoff_t x[4];
+  __m512d o, x0, x1, x2, x3;
+  __mmask8 mask;
+
+  r = 0;
+  while (r < n_rows) {
+    for(k=0 ; k<4 && r<n_rows ; r++) {
+      if (w[r] == 0.0) continue;
+      x[k] = scale * w[r];
+      row[k] = rows + r * stride;
+      k++;
+    }
+    for( ; k<4 ; k++) {
+      x[k] = 0.0;
+      row[k] = row[0];
+    }
+    if (x[0] == 0.0) break;
+
+    x0 = _mm512_set1_pd(x[0]);
+    x1 = _mm512_set1_pd(x[1]);
+    x2 = _mm512_set1_pd(x[2]);
+    x3 = _mm512_set1_pd(x[3]);
+    for(a=0 ; a<m ; a+=8) {
+      // the last block is masked
+      mask = (m - a >= 8) ? 0xff : (__mmask8)((1 << (m - a)) - 1);
+      o = _mm512_maskz_loadu_pd(mask, out+a);
+      o = _mm512_fmadd_pd(x0, _mm512_maskz_loadu_pd(mask, row[0]+a), o);
+      o = _mm512_fmadd_pd(x1, _mm512_maskz_loadu_pd(mask, row[1]+a), o);
+      o = _mm512_fmadd_pd(x2, _mm512_maskz_loadu_pd(mask, row[2]+a), o);
+      o = _mm512_fmadd_pd(x3, _mm512_maskz_loadu_pd(mask, row[3]+a), o);
+      _mm512_mask_storeu_pd(out+a, mask, o);
+    }
+  }
+}
+
+__attribute__((target("avx512f")))
+static void lri_update_avx512(proba_t *p, int m, int action, payoff_t step)
+{
+  int i, c;
+  proba_t x, pa, sum;
+  __m512 v, vx, zero, vsum;
+  __mmask16 mask, gt;
+
+  zero = _mm512_setzero_ps();
+  c = 0;
+  for(i=0 ; i<m ; i+=16) {
+    // the last block is masked; the missing values read as 0
+    mask = (m - i >= 16) ? 0xffff : (__mmask16)((1 << (m - i)) - 1);
+    v = _mm512_maskz_loadu_ps(mask, p+i);
+    c += __builtin_popcount(_mm512_cmp_ps_mask(v, zero, _CMP_GT_OQ));
+  }
+  assert(c > 0);
+
+  x = step * (1.0 - p[action]);
+  pa = p[action] + x;
+  x /= c;
+  p[action] = 0.0;
+
+  vx = _mm512_set1_ps(x);
+  vsum = zero;
+  for(i=0 ; i<m ; i+=16) {
+    mask = (m - i >= 16) ? 0xffff : (__mmask16)((1 << (m - i)) - 1);
+    v = _mm512_maskz_loadu_ps(mask, p+i);
+    gt = _mm512_cmp_ps_mask(v, zero, _CMP_GT_OQ);
+    v = _mm512_mask_max_ps(v, gt, _mm512_sub_ps(v, vx), zero);
+    _mm512_mask_storeu_ps(p+i, mask, v);
+    vsum = _mm512_add_ps(vsum, v);
+  }
+  p[action] = pa;
+  sum = _mm512_reduce_add_ps(vsum) + pa;
+
+  vsum = _mm512_set1_ps(sum);
+  for(i=0 ; i<m ; i+=16) {
+    mask = (m - i >= 16) ? 0xffff : (__mmask16)((1 << (m - i)) - 1);
+    v = _mm512_maskz_loadu_ps(mask, p+i);
+    _mm512_mask_storeu_ps(p+i, mask, _mm512_div_ps(v, vsum));
+  }
+}
+
+#endif /* GATHA_SIMD_X86 */
+
+/* --- dispatch --- */
+
+/* the kernels are selected once, when the library is loaded, so that the
+   threads of MCB and SFP only ever read these; until then, and on CPUs
+   without a vectorized version, the scalar kernels are used */
+static GathaSimdLevel simd_supported = GATHA_SIMD_SCALAR;
+static GathaSimdLevel simd_current = GATHA_SIMD_SCALAR;
+
+static void (*weighted_rows_func)(const payoff_t*, long, const proba_t*,
+				  payoff_t, int, int, payoff_t*)
+  = weighted_rows_scalar;
+static void (*lri_update_func)(proba_t*, int, int, payoff_t)
+  = lri_update_scalar;
+
+static GathaSimdLevel simd_detect(void)
+{
+#ifdef GATHA_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return GATHA_SIMD_AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return GATHA_SIMD_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return GATHA_SIMD_SSE2;
+#endif
+  return GATHA_SIMD_SCALAR;
+}
+
+GathaSimdLevel gatha_simd_set_level(GathaSimdLevel level)
+{
+  if (level > simd_supported) level = simd_supported;
+
+  switch(level) {
+#ifdef GATHA_SIMD_X86
+  case GATHA_SIMD_AVX512:
+    weighted_rows_func = weighted_rows_avx512;
+    lri_update_func = lri_update_avx512;
+    break;
+  case GATHA_SIMD_AVX2:
+    weighted_rows_func = weighted_rows_avx2;
+    lri_update_func = lri_update_avx2;
+    break;
+  case GATHA_SIMD_SSE2:
+    weighted_rows_func = weighted_rows_scalar;
+    lri_update_func = lri_update_sse2;
+    break;
+#endif
+  default:
+    level = GATHA_SIMD_SCALAR;
+    weighted_rows_func = weighted_rows_scalar;
+    lri_update_func = lri_update_scalar;
+  }
+  simd_current = level;
+  return level;
+}
+
+#ifdef GATHA_SIMD_X86
+__attribute__((constructor)) static void simd_init(void)
+{
+  simd_supported = simd_detect();
+  gatha_simd_set_level(GATHA_SIMD_AVX512);
+}
+#endif
+
+GathaSimdLevel gatha_simd_level(void)
+{
+  return simd_current;
+}
+
+void gatha_simd_weighted_rows(const payoff_t *rows, long stride,
+			      const proba_t *w, int n_rows, int m,
+			      payoff_t *out)
+{
+  int a;
+
+  for(a=0 ; a<m ; a++) {
+    out[a] = 0.0;
+  }
+  gatha_simd_weighted_rows_add(rows, stride, w, 1.0, n_rows, m, out);
+}
+
+void gatha_simd_weighted_rows_add(const payoff_t *rows, long stride,
+				  const proba_t *w, payoff_t scale,
+				  int n_rows, int m, payoff_t *out)
+{
+  weighted_rows_func(rows, stride, w, scale, n_rows, m, out);
+}
+
+void gatha_simd_lri_update(proba_t *p, int m, int action, payoff_t step)
+{
+  assert(action >= 0 && action < m);
+  lri_update_func(p, m, action, step);
+}
+
+int gatha_simd_argmax(const payoff_t *v, int m)
+{
+  int i, best;
+
+  assert(m > 0);
+  best = 0;
+  for(i=1 ; i<m ; i++) {
+    if (v[i] > v[best]) best = i;
+  }
+  return best;
+}
@@ -0,0 +1,70 @@
+#ifndef _GATHA_SIMD_H_
+#define _GATHA_SIMD_H_
+
+#include "types.h"
+
+/** Instruction sets the vectorized kernels can use. The best one supported by
+ * the CPU is selected at run time. Kernels without a version for a level use
+ * the one of the level below. */
+typedef enum {
+  GATHA_SIMD_SCALAR = 0,
+  GATHA_SIMD_SSE2,
+  GATHA_SIMD_AVX2,
+  GATHA_SIMD_AVX512
+} GathaSimdLevel;
+
+/** Returns the instruction set used by the vectorized kernels. */
+extern GathaSimdLevel gatha_simd_level(void);
+
+/** Forces the instruction set used by the vectorized kernels, for example to
+ * compare them. Levels the CPU does not support are lowered to the best
+ * supported one. The best level is selected when the library is loaded; this
+ * must not be called while other threads use the kernels, for example during
+ * gatha_mcb or gatha_sfp.
+ * @returns The level actually used.
+ */
+extern GathaSimdLevel gatha_simd_set_level(GathaSimdLevel level);
+
+/** Computes the weighted sum of the rows of a matrix:
+ * out[a] = sum over r of w[r] * rows[r*stride + a].
+ * Rows with a zero weight are skipped. With the payoffs of a player stored
+ * with its own strategy innermost, this is its expected payoff for each of
+ * its strategies against the probability vector `w' of its opponent.
+ * @param rows The matrix, with n_rows rows of m elements
+ * @param stride Distance between the beginning of two rows
+ * @param w The n_rows weights
+ * @param n_rows Number of rows
+ * @param m Number of columns
+ * @param[out] out The m weighted sums
+ */
+extern void gatha_simd_weighted_rows(const payoff_t *rows, long stride,
+				     const proba_t *w, int n_rows, int m,
+				     payoff_t *out);
+
+/** Same as gatha_simd_weighted_rows, but adds the weighted sum, multiplied by
+ * `scale', to `out' instead of overwriting it. */
+extern void gatha_simd_weighted_rows_add(const payoff_t *rows, long stride,
+					 const proba_t *w, payoff_t scale,
+					 int n_rows, int m, payoff_t *out);
+
+/** Linear reward-inaction update of a probability vector, followed by its
+ * normalization. The probability of the chosen strategy grows by
+ * x = step * (1 - p[action]), and x/c is removed from the other strategies
+ * of non-zero probability, where c is the number of strategies of non-zero
+ * probability, without going below 0. Used by Sastry and MCB with step equal
+ * to the learning rate times the payoff. The scalar version gives the same
+ * results as the update and normalization done separately; the vector ones
+ * may differ in the last bits of the sum.
+ * @param p The m probabilities of a player
+ * @param m Number of strategies
+ * @param action The chosen strategy
+ * @param step Learning rate times the payoff of the chosen strategy
+ */
+extern void gatha_simd_lri_update(proba_t *p, int m, int action,
+				  payoff_t step);
+
+/** Returns the index of the largest of m values. Ties go to the lowest index.
+ */
+extern int gatha_simd_argmax(const payoff_t *v, int m);
+
+#endif /* _GATHA_SIMD_H_ */
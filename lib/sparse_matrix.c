@@ -0,0 +1,220 @@
+#include "sparse_matrix.h"
+#include "game.h"
+
+#include <string.h>
+
+GathaSparseMatrix* gatha_sparse_matrix_new(int p, int s)
+{
+  GathaSparseMatrix *m;
+  int i;
+  uint64_t n;
+
+  assert(p > 1 && s > 0);
+
+  // the keys of all the choices of strategies must fit in 64 bits
+  n = 1;
+  for(i=0 ; i<p ; i++) {
+    assert(n <= UINT64_MAX / s);
+    n *= s;
+  }
+
+  m = (GathaSparseMatrix *) malloc(sizeof(GathaSparseMatrix));
+  if (m == NULL) return NULL;
+
+  m->n_players = p;
+  m->n_strategies = s;
+  m->n_entries = 0;
+  m->capacity = 16;
+  m->keys = (uint64_t*) malloc(m->capacity * sizeof(uint64_t));
+  m->payoffs = (payoff_t*) malloc(m->capacity * p * sizeof(payoff_t));
+  m->n_slots = 2 * m->capacity;
+  m->slots = (long*) calloc(m->n_slots, sizeof(long));
+  assert(m->keys != NULL && m->payoffs != NULL && m->slots != NULL);
+
+  return m;
+}
+
+void gatha_sparse_matrix_free(GathaSparseMatrix *m)
+{
+  assert(m != NULL);
+  free(m->keys);
+  free(m->payoffs);
+  free(m->slots);
+  free(m);
+}
+
+static void sparse_matrix_game_expected_payoffs(GathaGame *g, int player,
+						proba_t **proba, payoff_t *payoffs,
+						int thread_id)
+{
+  gatha_sparse_matrix_expected_payoffs((GathaSparseMatrix*) g->data,
+				       player, proba, payoffs);
+}
+
+GathaGame* gatha_game_from_sparse_matrix(GathaSparseMatrix *m)
+{
+  GathaGame *g;
+  assert(m != NULL);
+  g = gatha_game_new(m->n_players, m->n_strategies);
+  g->payoff_func = gatha_sparse_matrix_payoffs;
+  g->expected_payoffs_func = sparse_matrix_game_expected_payoffs;
+  g->data = m;
+  return g;
+}
+
+uint64_t gatha_sparse_matrix_key(GathaSparseMatrix *m, const int *actions)
+{
+  int i;
+  uint64_t key;
+
+  key = 0;
+  for(i=m->n_players-1 ; i>=0 ; i--) {
+    key = key * m->n_strategies + actions[i];
+  }
+  return key;
+}
+
+/* first slot to probe for a key: the keys of neighbouring choices of
+   strategies are consecutive, so they are mixed first */
+static inline long sparse_matrix_hash(GathaSparseMatrix *m, uint64_t key)
+{
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return (long) (key & (m->n_slots - 1));
+}
+
+/* slot of a key, either holding its entry or the empty slot where it would
+   be inserted */
+static long sparse_matrix_slot(GathaSparseMatrix *m, uint64_t key)
+{
+  long h;
+
+  h = sparse_matrix_hash(m, key);
+  while (m->slots[h] != 0 && m->keys[m->slots[h] - 1] != key) {
+    h = (h + 1) & (m->n_slots - 1);
+  }
+  return h;
+}
+
+/* doubles the capacity, and rebuilds the hash table so that it stays at most
+   half full */
+static void sparse_matrix_grow(GathaSparseMatrix *m)
+{
+  long e;
+
+  m->capacity *= 2;
+  m->keys = (uint64_t*) realloc(m->keys, m->capacity * sizeof(uint64_t));
+  m->payoffs = (payoff_t*) realloc(m->payoffs,
+				   m->capacity * m->n_players * sizeof(payoff_t));
+  free(m->slots);
+  m->n_slots = 2 * m->capacity;
+  m->slots = (long*) calloc(m->n_slots, sizeof(long));
+  assert(m->keys != NULL && m->payoffs != NULL && m->slots != NULL);
+
+  for(e=0 ; e<m->n_entries ; e++) {
+    m->slots[sparse_matrix_slot(m, m->keys[e])] = e + 1;
+  }
+}
+
+void gatha_sparse_matrix_set_v(GathaSparseMatrix *m, int player,
+			       const int *actions, payoff_t value)
+{
+  uint64_t key;
+  long h, e;
+
+  assert(player >= 0 && player < m->n_players);
+  key = gatha_sparse_matrix_key(m, actions);
+  h = sparse_matrix_slot(m, key);
+  if (m->slots[h] == 0) {
+    // setting a missing payoff to 0 changes nothing
+    if (value == 0.0) return;
+    if (m->n_entries == m->capacity) {
+      sparse_matrix_grow(m);
+      h = sparse_matrix_slot(m, key);
+    }
+    e = m->n_entries++;
+    m->keys[e] = key;
+    memset(m->payoffs + e * m->n_players, 0, m->n_players * sizeof(payoff_t));
+    m->slots[h] = e + 1;
+  }
+  e = m->slots[h] - 1;
+  m->payoffs[e * m->n_players + player] = value;
+}
+
+void gatha_sparse_matrix_set(GathaSparseMatrix *m, int player,
+			     payoff_t value, ...)
+{
+  va_list arg;
+  int i;
+  int *actions;
+
+  actions = (int*) malloc(m->n_players * sizeof(int));
+  assert(actions != NULL);
+  va_start(arg, value);
+  for(i=0 ; i<m->n_players ; i++) {
+    actions[i] = va_arg(arg, int);
+  }
+  va_end(arg);
+
+  gatha_sparse_matrix_set_v(m, player, actions, value);
+  free(actions);
+}
+
+payoff_t gatha_sparse_matrix_get_v(GathaSparseMatrix *m, int player,
+				   const int *actions)
+{
+  long e;
+
+  e = m->slots[sparse_matrix_slot(m, gatha_sparse_matrix_key(m, actions))];
+  if (e == 0) return 0.0;
+  return m->payoffs[(e - 1) * m->n_players + player];
+}
+
+void gatha_sparse_matrix_payoffs(GathaGame *g, int *actions,
+				 payoff_t *payoffs, int thread_id)
+{
+  GathaSparseMatrix *m;
+  long e;
+
+  m = (GathaSparseMatrix*) g->data;
+  e = m->slots[sparse_matrix_slot(m, gatha_sparse_matrix_key(m, actions))];
+  if (e == 0) {
+    memset(payoffs, 0, m->n_players * sizeof(payoff_t));
+  } else {
+    memcpy(payoffs, m->payoffs + (e - 1) * m->n_players,
+	   m->n_players * sizeof(payoff_t));
+  }
+}
+
+void gatha_sparse_matrix_expected_payoffs(GathaSparseMatrix *m, int player,
+					  proba_t **proba, payoff_t *payoffs)
+{
+  int i, s, own, a;
+  long e;
+  uint64_t key;
+  payoff_t w, v;
+
+  assert(player >= 0 && player < m->n_players);
+  s = m->n_strategies;
+  for(a=0 ; a<s ; a++) {
+    payoffs[a] = 0.0;
+  }
+
+  for(e=0 ; e<m->n_entries ; e++) {
+    v = m->payoffs[e * m->n_players + player];
+    if (v == 0.0) continue;
+    // decode the key, and weight the entry by the probability that the
+    // opponents choose its strategies
+    key = m->keys[e];
+    w = 1.0;
+    own = 0;
+    for(i=0 ; i<m->n_players && w != 0.0 ; i++) {
+      a = (int) (key % s);
+      key /= s;
+      if (i == player) own = a;
+      else w *= proba[i][a];
+    }
+    if (w != 0.0) payoffs[own] += w * v;
+  }
+}
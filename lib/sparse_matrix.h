@@ -0,0 +1,98 @@
+#ifndef _GATHA_SPARSE_MATRIX_H_
+#define _GATHA_SPARSE_MATRIX_H_
+
+#include "types.h"
+
+#include <stdarg.h>
+#include <stdint.h>
+
+/** Normal Form game with mostly zero payoffs. Only the choices of strategies
+ *  with a non-zero payoff are stored: a dense array of entries, each holding
+ *  the payoffs of all the players, indexed by a hash table. Games far too
+ *  large for a GathaPayoffMatrix can be stored, as long as the number of
+ *  entries is reasonable. */
+struct _gatha_sparse_matrix {
+
+  /** Number of players in the game. */
+  int n_players;
+
+  /** Number of strategies for each player. */
+  int n_strategies;
+
+  /** Number of stored entries. */
+  long n_entries;
+
+  /** Allocated size of the `keys' and `payoffs' arrays, in entries. */
+  long capacity;
+
+  /** Key of each entry: the index of its choice of strategies, the first
+   * player's strategy changing first, ie. the sum of actions[i]*n_strategies^i.
+   * \see gatha_sparse_matrix_key */
+  uint64_t *keys;
+
+  /** Payoffs of the entries, n_players consecutive values for each entry. */
+  payoff_t *payoffs;
+
+  /** Hash table: index+1 of the entry of a key, or 0 for an empty slot.
+   * Collisions are resolved by linear probing. */
+  long *slots;
+
+  /** Number of slots, a power of two. */
+  long n_slots;
+} ;
+
+/** Creates an empty GathaSparseMatrix: all the payoffs are 0.
+ * @param np Number of players.
+ * @param ns Number of strategies for each player.
+ * ns^np must fit in 64 bits.
+ */
+extern GathaSparseMatrix* gatha_sparse_matrix_new(int np, int ns);
+
+/** Frees a GathaSparseMatrix. */
+extern void gatha_sparse_matrix_free(GathaSparseMatrix *m);
+
+/** Creates a game using a sparse matrix for computing the payoffs. */
+extern GathaGame* gatha_game_from_sparse_matrix(GathaSparseMatrix *m);
+
+/** Returns the key of a choice of strategies.
+ * \see keys */
+extern uint64_t gatha_sparse_matrix_key(GathaSparseMatrix *m, const int *actions);
+
+/** Sets the payoff of a player, given an array of strategy choices. An entry
+ * is created for the choice of strategies if needed.
+ * @param m The game matrix
+ * @param player The player
+ * @param actions The strategy choices of all the players
+ * @param value The new payoff value
+ */
+extern void gatha_sparse_matrix_set_v(GathaSparseMatrix *m, int player,
+				      const int *actions, payoff_t value);
+
+/** Variadic version of gatha_sparse_matrix_set_v.
+ * \see gatha_payoff_matrix_set */
+extern void gatha_sparse_matrix_set(GathaSparseMatrix *m, int player,
+				    payoff_t value, ...);
+
+/** Retrieves the payoff of a player, given an array of strategy choices.
+ * @returns The payoff, or 0 if there is no entry for these strategies.
+ */
+extern payoff_t gatha_sparse_matrix_get_v(GathaSparseMatrix *m, int player,
+					  const int *actions);
+
+/** Retrieves the players' payoffs for a choice of strategies. This is the
+ * payoff callback used by gatha_game_from_sparse_matrix.
+ * \see gatha_payoff_matrix_payoffs
+ */
+extern void gatha_sparse_matrix_payoffs(GathaGame *g, int *actions,
+					payoff_t *payoffs, int thread_id);
+
+/** Computes the exact expected payoff of each strategy of a player, when the
+ * other players choose their strategies according to their probability vectors.
+ * Only the stored entries are visited, so the cost is proportional to their
+ * number, whatever the size of the game.
+ * \see gatha_payoff_matrix_expected_payoffs
+ */
+extern void gatha_sparse_matrix_expected_payoffs(GathaSparseMatrix *m, int player,
+						 proba_t **proba, payoff_t *payoffs);
+
+#endif /* _GATHA_SPARSE_MATRIX_H_ */
@@ -0,0 +1,307 @@
+#include "symmetric_matrix.h"
+#include "payoff_matrix.h"
+#include "game.h"
+#include "simd.h"
+
+#include <string.h>
+
+#define BINOMIAL(m, n, k) ((m)->binomials[(n) * (m)->n_players + (k)])
+
+GathaSymmetricMatrix* gatha_symmetric_matrix_new(int p, int s)
+{
+  GathaSymmetricMatrix *m;
+  int n, k, rows;
+  long size;
+
+  assert(p > 1 && s > 0);
+
+  m = (GathaSymmetricMatrix *) malloc(sizeof(GathaSymmetricMatrix));
+  if (m == NULL) return NULL;
+
+  m->n_players = p;
+  m->n_strategies = s;
+
+  // Pascal's triangle, up to C(s+p-2, p-1)
+  rows = s + p - 1;
+  m->binomials = (long*) calloc(rows * p, sizeof(long));
+  assert(m->binomials != NULL);
+  for(n=0 ; n<rows ; n++) {
+    BINOMIAL(m, n, 0) = 1;
+    for(k=1 ; k<p && k<=n ; k++) {
+      BINOMIAL(m, n, k) = BINOMIAL(m, n-1, k-1) + BINOMIAL(m, n-1, k);
+      assert(BINOMIAL(m, n, k) > 0);
+    }
+  }
+  m->n_multisets = BINOMIAL(m, s + p - 2, p - 1);
+
+  size = m->n_multisets * s;
+  assert(size / s == m->n_multisets);
+  m->payoffs = (payoff_t*) calloc(size, sizeof(payoff_t));
+  assert(m->payoffs != NULL);
+
+  m->max_payoff = 0;
+  m->max_payoff_count = size;
+
+  return m;
+}
+
+void gatha_symmetric_matrix_free(GathaSymmetricMatrix *m)
+{
+  assert(m != NULL);
+  free(m->payoffs);
+  free(m->binomials);
+  free(m);
+}
+
+static void symmetric_matrix_game_expected_payoffs(GathaGame *g, int player,
+						   proba_t **proba, payoff_t *payoffs,
+						   int thread_id)
+{
+  gatha_symmetric_matrix_expected_payoffs((GathaSymmetricMatrix*) g->data,
+					  player, proba, payoffs);
+}
+
+GathaGame* gatha_game_from_symmetric_matrix(GathaSymmetricMatrix *m)
+{
+  GathaGame *g;
+  assert(m != NULL);
+  g = gatha_game_new(m->n_players, m->n_strategies);
+  g->payoff_func = gatha_symmetric_matrix_payoffs;
+  g->expected_payoffs_func = symmetric_matrix_game_expected_payoffs;
+  g->data = m;
+  return g;
+}
+
+long gatha_symmetric_matrix_rank(GathaSymmetricMatrix *m, int player,
+				 const int *actions)
+{
+  int i, k, j;
+  long r;
+
+  // the position of an opponent in the sorted multiset is the number of
+  // opponents before it, ties being broken by the player index
+  r = 0;
+  for(i=0 ; i<m->n_players ; i++) {
+    if (i == player) continue;
+    j = 0;
+    for(k=0 ; k<m->n_players ; k++) {
+      if (k == player || k == i) continue;
+      if (actions[k] < actions[i] || (actions[k] == actions[i] && k < i)) j++;
+    }
+    r += BINOMIAL(m, actions[i] + j, j + 1);
+  }
+  return r;
+}
+
+/* rank of a sorted multiset of n strategies */
+static long symmetric_matrix_encode(GathaSymmetricMatrix *m, const int *c, int n)
+{
+  int j;
+  long r;
+
+  r = 0;
+  for(j=0 ; j<n ; j++) {
+    r += BINOMIAL(m, c[j] + j, j + 1);
+  }
+  return r;
+}
+
+/* sorted multiset of n strategies of rank r */
+static void symmetric_matrix_decode(GathaSymmetricMatrix *m, long r, int *c, int n)
+{
+  int j, d;
+
+  for(j=n-1 ; j>=0 ; j--) {
+    // largest d such that C(d, j+1) <= r
+    d = j;
+    while (BINOMIAL(m, d + 1, j + 1) <= r) d++;
+    c[j] = d - j;
+    r -= BINOMIAL(m, d, j + 1);
+  }
+}
+
+static void symmetric_matrix_compute_max_payoff(GathaSymmetricMatrix *m)
+{
+  long i, size, count;
+  payoff_t max;
+
+  size = m->n_multisets * m->n_strategies;
+  max = m->payoffs[0];
+  count = 1;
+  for(i=1 ; i<size ; i++) {
+    if (m->payoffs[i] > max) {
+      max = m->payoffs[i];
+      count = 1;
+    } else if (m->payoffs[i] == max) {
+      count++;
+    }
+  }
+  m->max_payoff = max;
+  m->max_payoff_count = count;
+}
+
+payoff_t gatha_symmetric_matrix_max_payoff(GathaSymmetricMatrix *m)
+{
+  return m->max_payoff;
+}
+
+void gatha_symmetric_matrix_set_v(GathaSymmetricMatrix *m, const int *actions,
+				  payoff_t value)
+{
+  long p;
+  payoff_t old;
+
+  p = gatha_symmetric_matrix_rank(m, 0, actions) * m->n_strategies + actions[0];
+  old = m->payoffs[p];
+  m->payoffs[p] = value;
+
+  // as in GathaPayoffMatrix, the maximum is computed again when its last
+  // copy is overwritten
+  if (value > m->max_payoff) {
+    m->max_payoff = value;
+    m->max_payoff_count = 1;
+  } else if (value == m->max_payoff) {
+    if (old != m->max_payoff) m->max_payoff_count++;
+  } else if (old == m->max_payoff && --m->max_payoff_count == 0) {
+    symmetric_matrix_compute_max_payoff(m);
+  }
+}
+
+void gatha_symmetric_matrix_set(GathaSymmetricMatrix *m, payoff_t value, ...)
+{
+  va_list arg;
+  int i;
+  int *actions;
+
+  actions = (int*) malloc(m->n_players * sizeof(int));
+  assert(actions != NULL);
+  va_start(arg, value);
+  for(i=0 ; i<m->n_players ; i++) {
+    actions[i] = va_arg(arg, int);
+  }
+  va_end(arg);
+
+  gatha_symmetric_matrix_set_v(m, actions, value);
+  free(actions);
+}
+
+payoff_t gatha_symmetric_matrix_get_v(GathaSymmetricMatrix *m, int player,
+				      const int *actions)
+{
+  return m->payoffs[gatha_symmetric_matrix_rank(m, player, actions)
+		    * m->n_strategies + actions[player]];
+}
+
+void gatha_symmetric_matrix_payoffs(GathaGame *g, int *actions,
+				    payoff_t *payoffs, int thread_id)
+{
+  int i;
+  GathaSymmetricMatrix *m;
+
+  m = (GathaSymmetricMatrix*) g->data;
+  for(i=0 ; i<m->n_players ; i++) {
+    payoffs[i] = gatha_symmetric_matrix_get_v(m, i, actions);
+  }
+}
+
+GathaSymmetricMatrix* gatha_symmetric_matrix_from_payoff_matrix(GathaPayoffMatrix *pm)
+{
+  GathaSymmetricMatrix *m;
+  int i, k, p, s;
+  long c, n, e;
+  int *actions;
+  // elements already set by a previous choice of strategies
+  char *seen;
+  payoff_t value;
+
+  p = pm->n_players;
+  s = pm->n_strategies;
+  m = gatha_symmetric_matrix_new(p, s);
+  if (m == NULL) return NULL;
+
+  seen = (char*) calloc(m->n_multisets * s, sizeof(char));
+  actions = (int*) calloc(p, sizeof(int));
+  assert(seen != NULL && actions != NULL);
+
+  n = pm->size / p;
+  for(c=0 ; c<n && m!=NULL ; c++) {
+    for(i=0 ; i<p ; i++) {
+      value = gatha_payoff_matrix_get_v(pm, i, actions);
+      e = gatha_symmetric_matrix_rank(m, i, actions) * s + actions[i];
+      if (!seen[e]) {
+	m->payoffs[e] = value;
+	seen[e] = 1;
+      } else if (m->payoffs[e] != value) {
+	// not symmetric
+	gatha_symmetric_matrix_free(m);
+	m = NULL;
+	break;
+      }
+    }
+    for(k=0 ; k<p && ++actions[k] == s ; k++) {
+      actions[k] = 0;
+    }
+  }
+
+  free(actions);
+  free(seen);
+  if (m != NULL) symmetric_matrix_compute_max_payoff(m);
+  return m;
+}
+
+void gatha_symmetric_matrix_expected_payoffs(GathaSymmetricMatrix *m,
+					     int player, proba_t **proba,
+					     payoff_t *payoffs)
+{
+  int a, i, j, k, p, s, n;
+  long r, count, next_count;
+  // distributions of the multisets of the first j opponents
+  proba_t *dist, *next, *tmp;
+  // a multiset of j opponents, and the same one with one more strategy
+  int *c, *c2;
+
+  p = m->n_players;
+  s = m->n_strategies;
+  assert(player >= 0 && player < p);
+
+  dist = (proba_t*) malloc(m->n_multisets * sizeof(proba_t));
+  next = (proba_t*) malloc(m->n_multisets * sizeof(proba_t));
+  c = (int*) malloc(2 * p * sizeof(int));
+  assert(dist != NULL && next != NULL && c != NULL);
+  c2 = c + p;
+
+  // the empty multiset
+  dist[0] = 1.0;
+  count = 1;
+  j = 0;
+  for(i=0 ; i<p ; i++) {
+    if (i == player) continue;
+    // number of multisets of j+1 strategies
+    next_count = BINOMIAL(m, s + j, j + 1);
+    memset(next, 0, next_count * sizeof(proba_t));
+    for(r=0 ; r<count ; r++) {
+      if (dist[r] == 0.0) continue;
+      symmetric_matrix_decode(m, r, c, j);
+      for(a=0 ; a<s ; a++) {
+	if (proba[i][a] == 0.0) continue;
+	// insert a in the sorted multiset
+	n = 0;
+	for(k=0 ; k<j && c[k]<=a ; k++) c2[n++] = c[k];
+	c2[n++] = a;
+	for( ; k<j ; k++) c2[n++] = c[k];
+	next[symmetric_matrix_encode(m, c2, j + 1)] += dist[r] * proba[i][a];
+      }
+    }
+    tmp = dist;
+    dist = next;
+    next = tmp;
+    count = next_count;
+    j++;
+  }
+
+  gatha_simd_weighted_rows(m->payoffs, s, dist, m->n_multisets, s, payoffs);
+
+  free(c);
+  free(next);
+  free(dist);
+}
@@ -0,0 +1,122 @@
+#ifndef _GATHA_SYMMETRIC_MATRIX_H_
+#define _GATHA_SYMMETRIC_MATRIX_H_
+
+#include "types.h"
+
+#include <stdarg.h>
+
+/** Symmetric Normal Form game. The payoff of a player only depends on its own
+ *  strategy and on the multiset of the strategies of the other players, and
+ *  not on who plays what. Only one player's payoffs are stored, for each of
+ *  its strategies and each sorted multiset of opponent strategies:
+ *  n_strategies * C(n_strategies+n_players-2, n_players-1) elements instead of
+ *  n_strategies^(n_players+1) for a GathaPayoffMatrix. */
+struct _gatha_symmetric_matrix {
+
+  /** Number of players in the game. */
+  int n_players;
+
+  /** Number of strategies for each player. */
+  int n_strategies;
+
+  /** Number of multisets of n_players-1 opponent strategies. */
+  long n_multisets;
+
+  /** Payoffs, n_multisets rows of n_strategies elements:
+   * payoffs[r*n_strategies + a] is the payoff of a player choosing strategy
+   * a while its opponents choose the multiset of rank r. The array should
+   * not be accessed directly, but through accessors like
+   * gatha_symmetric_matrix_get and _set.
+   * \see gatha_symmetric_matrix_rank */
+  payoff_t *payoffs;
+
+  /** Binomial coefficients used to rank the multisets:
+   * binomials[n*n_players + k] is C(n, k). */
+  long *binomials;
+
+  /** Maximum payoff in the matrix, maintained by the setters.
+   * \see GathaPayoffMatrix::max_payoff */
+  payoff_t max_payoff;
+
+  /** Number of payoffs equal to `max_payoff', so that the maximum is only
+   * computed again when the last of them is overwritten.
+   * \see GathaPayoffMatrix::max_payoff_count */
+  long max_payoff_count;
+} ;
+
+/** Creates a GathaSymmetricMatrix, with all payoffs set to 0.
+ * @param np Number of players.
+ * @param ns Number of strategies for each player.
+ */
+extern GathaSymmetricMatrix* gatha_symmetric_matrix_new(int np, int ns);
+
+/** Creates the GathaSymmetricMatrix of a symmetric GathaPayoffMatrix.
+ * @returns The new matrix, or NULL if `m' is not symmetric.
+ */
+extern GathaSymmetricMatrix* gatha_symmetric_matrix_from_payoff_matrix(GathaPayoffMatrix *m);
+
+/** Frees a GathaSymmetricMatrix. */
+extern void gatha_symmetric_matrix_free(GathaSymmetricMatrix *m);
+
+/** Creates a game using a symmetric matrix for computing the payoffs. */
+extern GathaGame* gatha_game_from_symmetric_matrix(GathaSymmetricMatrix *m);
+
+/** Returns the rank of the multiset of the opponents' strategies of a player,
+ * ie. its row in the `payoffs' array. Multisets are ranked with the
+ * combinatorial number system: if c_0 <= c_1 <= ... are the sorted opponent
+ * strategies, the rank is the sum of C(c_j + j, j + 1).
+ * @param m The game matrix
+ * @param player The player, whose strategy is ignored
+ * @param actions The strategy choices of all the players
+ */
+extern long gatha_symmetric_matrix_rank(GathaSymmetricMatrix *m, int player,
+					const int *actions);
+
+/** Returns the maximum payoff of the matrix. It is kept up to date by the
+ * setters, so several threads can call this while no payoff is set. */
+extern payoff_t gatha_symmetric_matrix_max_payoff(GathaSymmetricMatrix *m);
+
+/** Sets the payoff of the first player for a choice of strategies, and
+ * thereby the payoff of any player for any permutation of the opponents.
+ * @param m The game matrix
+ * @param actions The strategy choices of all the players
+ * @param value The new payoff value
+ */
+extern void gatha_symmetric_matrix_set_v(GathaSymmetricMatrix *m,
+					 const int *actions, payoff_t value);
+
+/** Variadic version of gatha_symmetric_matrix_set_v.
+ * @param m The game matrix
+ * @param value The new payoff value
+ * @param ... The strategy choices of all the players
+ */
+extern void gatha_symmetric_matrix_set(GathaSymmetricMatrix *m,
+				       payoff_t value, ...);
+
+/** Retrieves the payoff of a player, given an array of strategy choices.
+ * @param m The game matrix
+ * @param player The player
+ * @param actions The strategy choices of all the players
+ */
+extern payoff_t gatha_symmetric_matrix_get_v(GathaSymmetricMatrix *m, int player,
+					     const int *actions);
+
+/** Retrieves the players' payoffs for a choice of strategies. This is the
+ * payoff callback used by gatha_game_from_symmetric_matrix.
+ * \see gatha_payoff_matrix_payoffs
+ */
+extern void gatha_symmetric_matrix_payoffs(GathaGame *g, int *actions,
+					   payoff_t *payoffs, int thread_id);
+
+/** Computes the exact expected payoff of each strategy of a player, when the
+ * other players choose their strategies according to their probability vectors.
+ * The distribution of the multiset of the opponents' strategies is built one
+ * opponent at a time, so the cost grows with the number of multisets rather
+ * than with n_strategies^(n_players-1).
+ * \see gatha_payoff_matrix_expected_payoffs
+ */
+extern void gatha_symmetric_matrix_expected_payoffs(GathaSymmetricMatrix *m,
+						    int player, proba_t **proba,
+						    payoff_t *payoffs);
+
+#endif /* _GATHA_SYMMETRIC_MATRIX_H_ */
@@ -23,6 +23,14 @@ typedef int    boolean;
 
 typedef struct _gatha_game GathaGame;
 typedef struct _gatha_payoff_matrix GathaPayoffMatrix;
+typedef struct _gatha_symmetric_matrix GathaSymmetricMatrix;
+typedef struct _gatha_sparse_matrix GathaSparseMatrix;
+typedef struct _gatha_polymatrix_game GathaPolymatrixGame;
+typedef struct _gatha_anonymous_game GathaAnonymousGame;
+typedef struct _gatha_payoff_cache GathaPayoffCache;
+typedef struct _gatha_payoff_store GathaPayoffStore;
+typedef struct _gatha_rng GathaRng;
+typedef struct _gatha_sampler GathaSampler;
 typedef struct _gatha_sastry_data GathaSastryData;
 typedef struct _gatha_mcb_data GathaMcbData;
 typedef struct _gatha_sfp_data GathaSfpData;